@@ -0,0 +1,46 @@
+/*
+ * benchmark_allocations.h
+ *
+ * Replaces the global operator new and delete to count the heap
+ * allocations and the live heap bytes, for the benchmarks that measure
+ * them. It defines the operators, so include it in one file of a
+ * benchmark only.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef BENCHMARK_ALLOCATIONS_H_
+#define BENCHMARK_ALLOCATIONS_H_
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+static unsigned long number_of_allocations = 0;
+
+/*
+ * live heap bytes, kept in a header in front of each allocation
+ */
+static long heap_bytes = 0;
+
+void* operator new(std::size_t size) {
+	number_of_allocations++;
+	void *p = std::malloc(size + sizeof(std::max_align_t));
+	if (!p) throw std::bad_alloc();
+	*static_cast<std::size_t*>(p) = size;
+	heap_bytes += size;
+	return static_cast<char*>(p) + sizeof(std::max_align_t);
+}
+
+void operator delete(void *p) noexcept {
+	if (!p) return;
+	char *base = static_cast<char*>(p) - sizeof(std::max_align_t);
+	heap_bytes -= *reinterpret_cast<std::size_t*>(base);
+	std::free(base);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+	operator delete(p);
+}
+
+#endif /* BENCHMARK_ALLOCATIONS_H_ */
@@ -0,0 +1,144 @@
+/*
+ * benchmark_asynchronous_nsm.cpp
+ *
+ * Ghost cell coupling of compartments (x < L/2) and Brownian molecules
+ * (x > L/2), with the NSM run synchronously and with its interior running
+ * asynchronously.
+ *
+ * First starts every molecule in the compartments and runs many times
+ * (400 by default, or the first argument) for 0.02 s, comparing the mean
+ * and variance of the number of molecules that have become particles. The
+ * asynchronous NSM delivers molecules crossing between the interior and
+ * the interface cells up to one timestep late, so the z scores show
+ * whether that delay is visible at this timestep.
+ *
+ * Then times a 32^3 grid with 4n molecules in the compartments and n
+ * particles (n = 10^5 by default, or the second argument). The synchronous
+ * run measures the time spent in the NSM and in the molecule operators.
+ * The asynchronous one overlaps the two, so on two or more cores its wall
+ * time should approach the larger of them rather than their sum.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include "benchmark_statistics.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+/*
+ * steps the coupled model, timing the NSM and the molecule operators
+ * separately
+ */
+struct Coupling {
+	Coupling(const int cells, const double h_yz, const int compartment_molecules, const int particles, const bool asynchronous):
+		L(1.0),A(1.0),
+		xghost(L/2,1),xhigh(L,-1),ylow(0,1),yhigh(L,-1),zlow(0,1),zhigh(L,-1),
+		interface(Vect3d(0,0,0),Vect3d(L/2,L,L),true),
+		grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(L/cells,h_yz,h_yz)),
+		nsm_seconds(0),molecule_seconds(0) {
+		/*
+		 * the ghost cell reactions reach outside their cells, so a
+		 * synchronous ParallelNextSubvolumeMethod would run the serial NSM
+		 */
+		if (asynchronous) {
+			std::auto_ptr<ParallelNextSubvolumeMethod> parallel = ParallelNextSubvolumeMethod::New(grid);
+			parallel->set_asynchronous(true);
+			nsm.reset(parallel.release());
+		} else {
+			nsm.reset(new NextSubvolumeMethod(grid));
+		}
+		NextSubvolumeMethod& nsm = *this->nsm;
+		nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(L/2,L,L),compartment_molecules);
+		nsm.add_diffusion(A);
+		A.fill_uniform(Vect3d(L/2,0,0),Vect3d(L,L,L),particles);
+		nsm.set_ghost_cell_interface(interface);
+		diffusion = DiffusionWithTracking<Box>::New(interface,&nsm);
+		molecules.push_back(diffusion.get());
+		boundaries.push_back(new ReflectiveBoundary<xplane>(xghost));
+		boundaries.push_back(new ReflectiveBoundary<xplane>(xhigh));
+		boundaries.push_back(new ReflectiveBoundary<yplane>(ylow));
+		boundaries.push_back(new ReflectiveBoundary<yplane>(yhigh));
+		boundaries.push_back(new ReflectiveBoundary<zplane>(zlow));
+		boundaries.push_back(new ReflectiveBoundary<zplane>(zhigh));
+		BOOST_FOREACH(Operator* o, boundaries) {
+			molecules.push_back(o);
+		}
+		BOOST_FOREACH(Operator* o, molecules.get_operators()) {
+			o->add_species(A);
+		}
+	}
+	~Coupling() {
+		nsm->synchronise();
+		BOOST_FOREACH(Operator* o, boundaries) {
+			delete o;
+		}
+	}
+	void step(const double dt) {
+		boost::timer::cpu_timer timer;
+		molecules(dt);
+		molecule_seconds += timer.elapsed().wall/1.0e9;
+		timer.start();
+		(*nsm)(dt);
+		nsm_seconds += timer.elapsed().wall/1.0e9;
+	}
+
+	const double L;
+	Species A;
+	xplane xghost,xhigh;
+	yplane ylow,yhigh;
+	zplane zlow,zhigh;
+	Box interface;
+	StructuredGrid grid;
+	std::auto_ptr<NextSubvolumeMethod> nsm;
+	std::auto_ptr<Operator> diffusion;
+	std::vector<Operator*> boundaries;
+	OperatorList molecules;
+	double nsm_seconds,molecule_seconds;
+};
+
+int main(int argc, char **argv) {
+	const int runs = argc > 1 ? atoi(argv[1]) : 400;
+	const int n = argc > 2 ? atoi(argv[2]) : 100000;
+	const double dt = 1.0e-4;
+
+	Moments particles[2];
+	for (int r = 0; r < runs; ++r) {
+		for (int asynchronous = 0; asynchronous < 2; ++asynchronous) {
+			random_seed(r+1);
+			Coupling coupling(20,1.0,100,0,asynchronous);
+			for (int i = 0; i < 200; ++i) {
+				coupling.step(dt);
+			}
+			particles[asynchronous].add(coupling.A.mols.size());
+		}
+	}
+	std::cout << "particles\tmean (sync)\tmean (async)\tz\tvariance (sync)\tvariance (async)\tz" << std::endl;
+	std::cout << "\t" << particles[0].mean() << "\t" << particles[1].mean() << "\t" << z_mean(particles[0],particles[1]) << "\t"
+			<< particles[0].variance() << "\t" << particles[1].variance() << "\t" << z_variance(particles[0],particles[1]) << std::endl << std::endl;
+
+	std::cout << 4*n << " molecules in compartments, " << n << " particles" << std::endl;
+	std::cout << "mode\tNSM (s)\tmolecules (s)\tsum (s)\tmax (s)\twall (s)" << std::endl;
+	const double h = 1.0/32;
+	for (int asynchronous = 0; asynchronous < 2; ++asynchronous) {
+		random_seed(1);
+		Coupling coupling(32,h,4*n,n,asynchronous);
+		boost::timer::cpu_timer timer;
+		for (int i = 0; i < 20; ++i) {
+			coupling.step(1.0e-6);
+		}
+		coupling.nsm->synchronise();
+		const double seconds = timer.elapsed().wall/1.0e9;
+		if (asynchronous) {
+			std::cout << "async\t\t\t\t\t" << seconds << std::endl;
+		} else {
+			std::cout << "sync\t" << coupling.nsm_seconds << "\t" << coupling.molecule_seconds << "\t"
+					<< coupling.nsm_seconds + coupling.molecule_seconds << "\t"
+					<< std::max(coupling.nsm_seconds,coupling.molecule_seconds) << "\t" << seconds << std::endl;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * benchmark_brownian_step.cpp
+ *
+ * Molecules per second per core stepped by Diffusion with each Brownian
+ * kernel this CPU supports, and by the previous scalar loop drawing three
+ * boost normals per molecule, for n molecules (10^6 by default, or the
+ * first argument). Everything runs on one thread. The kernels must give
+ * bit-identical positions for the same seed, and the benchmark fails if
+ * they do not.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace Tyche;
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 1000000;
+	const int number_of_steps = 20;
+	const double dt = 1.0e-3;
+	std::cout << n << " molecules, best kernel "
+			<< BrownianKernel::get_name(BrownianKernel::get_best_instruction_set()) << std::endl;
+	std::cout << "kernel\tmolecules per second per core\tmean square displacement (expected "
+			<< 2*number_of_steps*dt << ")" << std::endl;
+
+	std::vector<Vect3d> scalar_positions;
+	bool identical = true;
+	for (int set = BrownianKernel::SCALAR; set <= BrownianKernel::AVX512; ++set) {
+		const BrownianKernel::InstructionSet instruction_set = BrownianKernel::InstructionSet(set);
+		if (!BrownianKernel::is_supported(instruction_set)) continue;
+		random_seed(1);
+		Species A(1.0);
+		A.mols.fill_uniform(Vect3d(0,0,0),Vect3d(0,0,0),n);
+		Diffusion diffusion;
+		diffusion.get_kernel().set_instruction_set(instruction_set);
+		diffusion.add_species(A);
+
+		boost::timer::cpu_timer timer;
+		for (int i = 0; i < number_of_steps; ++i) {
+			diffusion(dt);
+		}
+		const double seconds = timer.elapsed().wall/1.0e9;
+		double msd = 0;
+		for (int i = 0; i < n; ++i) {
+			msd += A.mols.r[i][0]*A.mols.r[i][0];
+		}
+		std::cout << BrownianKernel::get_name(instruction_set) << "\t" << double(n)*number_of_steps/seconds
+				<< "\t" << msd/n << std::endl;
+
+		if (instruction_set == BrownianKernel::SCALAR) {
+			scalar_positions.assign(A.mols.r.begin(),A.mols.r.end());
+		} else if (memcmp(&A.mols.r[0],&scalar_positions[0],n*sizeof(Vect3d)) != 0) {
+			std::cout << BrownianKernel::get_name(instruction_set) << " positions differ from the scalar kernel" << std::endl;
+			identical = false;
+		}
+	}
+
+	random_seed(1);
+	Species A(1.0);
+	A.mols.fill_uniform(Vect3d(0,0,0),Vect3d(0,0,0),n);
+	boost::variate_generator<base_generator_type&, boost::normal_distribution<> > norm(generator,boost::normal_distribution<>(0,1));
+	const Vect3d step_length = (2.0*A.D*dt).cwiseSqrt();
+	boost::timer::cpu_timer timer;
+	for (int i = 0; i < number_of_steps; ++i) {
+		for (int j = 0; j < n; ++j) {
+			A.mols.r0[j] = A.mols.r[j];
+			A.mols.r[j] += step_length.cwiseProduct(Vect3d(norm(),norm(),norm()));
+		}
+	}
+	const double seconds = timer.elapsed().wall/1.0e9;
+	double msd = 0;
+	for (int i = 0; i < n; ++i) {
+		msd += A.mols.r[i][0]*A.mols.r[i][0];
+	}
+	std::cout << "boost\t" << double(n)*number_of_steps/seconds << "\t" << msd/n << std::endl;
+	return identical ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+/*
+ * benchmark_composition_rejection.cpp
+ *
+ * Event rate of the composition-rejection SSA against the NSM (pairing heap
+ * and indexed heap) for the setup of diffusion.py: three species with D = 1
+ * diffusing in the unit cube, here with 4 molecules of each per subvolume,
+ * on grids of 16^3 to 128^3 subvolumes. Each run lasts for about 2*10^6
+ * events.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <iostream>
+
+using namespace Tyche;
+
+template<typename T>
+double run(T& nsm, const double h) {
+	random_seed(1);
+	const Grid& grid = nsm.get_grid();
+	const int molecules_per_subvolume = 4;
+	Species A(1.0),B(1.0),C(1.0);
+	nsm.add_diffusion(A);
+	nsm.add_diffusion(B);
+	nsm.add_diffusion(C);
+	nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(1,1,1),molecules_per_subvolume*grid.size());
+	nsm.fill_uniform(B,Vect3d(0,0,0),Vect3d(1,1,1),molecules_per_subvolume*grid.size());
+	nsm.fill_uniform(C,Vect3d(0,0,0),Vect3d(1,1,1),molecules_per_subvolume*grid.size());
+	nsm(0);
+
+	const double jump_rate = 3*molecules_per_subvolume*grid.size()*6.0/(h*h);
+	boost::timer::cpu_timer timer;
+	nsm(2.0e6/jump_rate);
+	const double seconds = timer.elapsed().wall/1.0e9;
+	return nsm.get_number_of_events()/seconds;
+}
+
+int main(int argc, char **argv) {
+	std::cout << "grid\tnsm (events/s)\tnsm indexed heap (events/s)\tcomposition-rejection (events/s)\tspeedup" << std::endl;
+	for (int n = 16; n <= 128; n *= 2) {
+		const double h = 1.0/n;
+		const Vect3d low(0,0,0),high(1,1,1),spacing(h,h,h);
+
+		StructuredGrid nsm_grid(low,high,spacing);
+		NextSubvolumeMethod nsm(nsm_grid);
+		const double nsm_rate = run(nsm,h);
+
+		StructuredGrid indexed_grid(low,high,spacing);
+		NextSubvolumeMethod indexed(indexed_grid);
+		indexed.set_indexed_heap(true);
+		const double indexed_rate = run(indexed,h);
+
+		StructuredGrid cr_grid(low,high,spacing);
+		CompositionRejection cr(cr_grid);
+		const double cr_rate = run(cr,h);
+
+		std::cout << n << "^3\t" << nsm_rate << "\t" << indexed_rate << "\t" << cr_rate << "\t"
+				<< cr_rate/nsm_rate << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * benchmark_copy_numbers.cpp
+ *
+ * Reset time (recalculating every propensity) and event rate of the NSM
+ * on an n^3 grid (n = 64 by default, or the first argument) with 16
+ * species, all of them diffusing and reacting in every subvolume, with
+ * 32 and 16 bit copy numbers.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+void run(const int n, const bool narrow) {
+	random_seed(1);
+	const int number_of_species = 16;
+	const double L = 1.0;
+	const double h = L/n;
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	std::vector<Species*> species;
+	for (int i = 0; i < number_of_species; ++i) {
+		species.push_back(new Species(1.0e-3));
+	}
+
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(true);
+	nsm.add_diffusion(species);
+	for (int i = 0; i+1 < number_of_species; i += 2) {
+		nsm.add_reaction(1.0e-3,*species[i]+*species[i+1]>>*species[(i+2)%number_of_species]);
+		nsm.add_reaction(1.0,*species[(i+2)%number_of_species]>>*species[i]+*species[i+1]);
+	}
+	for (int i = 0; i < number_of_species; ++i) {
+		nsm.fill_uniform(*species[i],Vect3d(0,0,0),Vect3d(L,L,L),10*grid.size());
+	}
+	nsm.set_narrow_copy_numbers(narrow);
+	nsm(0);
+
+	boost::timer::cpu_timer reset_timer;
+	for (int i = 0; i < 5; ++i) {
+		nsm.reset();
+	}
+	const double reset_seconds = reset_timer.elapsed().wall/5.0e9;
+
+	boost::timer::cpu_timer timer;
+	nsm(0.02);
+	const double seconds = timer.elapsed().wall/1.0e9;
+
+	std::cout << (narrow ? "16 bit" : "32 bit") << "\t" << reset_seconds << "\t"
+			<< nsm.get_number_of_events()/seconds << std::endl;
+	for (int i = 0; i < number_of_species; ++i) {
+		delete species[i];
+	}
+}
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 64;
+	std::cout << "grid " << n << "^3" << std::endl;
+	std::cout << "copy numbers\treset time (s)\tevents/s" << std::endl;
+	run(n,false);
+	run(n,true);
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * benchmark_diffusion_tracking.cpp
+ *
+ * Molecules per second stepped by Diffusion and by DiffusionWithTracking
+ * with an interface halfway across a grid of c^3 cells (c = 32 by default,
+ * or the second argument), which tracks the c^2 cells next to it, for n
+ * molecules (10^6 by default, or the first argument).
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 1000000;
+	const int c = argc > 2 ? atoi(argv[2]) : 32;
+	const int number_of_steps = 10;
+	const double dt = 1.0e-6;
+	const double L = 1.0;
+	std::cout << n << " molecules, " << c*c << " tracked cells" << std::endl;
+	std::cout << "operator\tmolecules per second" << std::endl;
+
+	for (int tracking = 0; tracking < 2; ++tracking) {
+		random_seed(1);
+		Species A(1.0);
+		StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(L/c,L/c,L/c));
+		NextSubvolumeMethod nsm(grid);
+		nsm.add_diffusion(A);
+		Box interface(Vect3d(0,0,0),Vect3d(L/2,L,L),true);
+		nsm.set_ghost_cell_interface(interface);
+		A.fill_uniform(Vect3d(L/2,0,0),Vect3d(L,L,L),n);
+		std::auto_ptr<Operator> diffusion = tracking ?
+				DiffusionWithTracking<Box>::New(interface,&nsm) : Diffusion::New();
+		diffusion->add_species(A);
+
+		boost::timer::cpu_timer timer;
+		for (int i = 0; i < number_of_steps; ++i) {
+			(*diffusion)(dt);
+		}
+		const double seconds = timer.elapsed().wall/1.0e9;
+		std::cout << (tracking ? "DiffusionWithTracking" : "Diffusion") << "\t"
+				<< double(n)*number_of_steps/seconds << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * benchmark_event_queue.cpp
+ *
+ * Compares the events per second of the Next Subvolume Method using the
+ * boost pairing heap and the flat indexed heap as its event queue.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+double run(const int n, const bool use_indexed_heap, const unsigned int seed) {
+	random_seed(seed);
+	const double L = 1.0;
+	const double h = L/n;
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(use_indexed_heap);
+	Species A(1.0);
+	nsm.add_diffusion(A);
+	nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(L,L,L),10*grid.size());
+
+	const double dt = 0.1*h*h;
+	boost::timer::cpu_timer timer;
+	unsigned long events = 0;
+	while (events < 2000000) {
+		nsm(dt);
+		events = nsm.get_number_of_events();
+	}
+	const double seconds = timer.elapsed().wall/1.0e9;
+	return events/seconds;
+}
+
+int main(int argc, char **argv) {
+	const int sizes[] = {10, 50, 100};
+	std::cout << "cells\tpairing heap (events/s)\tindexed heap (events/s)\tspeedup" << std::endl;
+	for (int n : sizes) {
+		const double pairing = run(n,false,1);
+		const double indexed = run(n,true,1);
+		std::cout << n*n*n << "\t" << pairing << "\t" << indexed << "\t" << indexed/pairing << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * benchmark_lattice_diffusion.cpp
+ *
+ * Compares the throughput of NSM diffusion with multiparticle lattice
+ * diffusion (plus the NSM for the reactions) on an n^3 grid (n = 16 by
+ * default, or the first argument) with 10^3 molecules per cell, starting
+ * in the left half, converting slowly A <-> B.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+void run(const int n, const bool lattice) {
+	random_seed(1);
+	const double L = 1.0;
+	const double h = L/n;
+	const double dt = 0.01*h*h;
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	Species A(1.0),B(1.0);
+
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(true);
+	std::auto_ptr<LatticeDiffusion> diffusion;
+	OperatorList operators;
+	if (lattice) {
+		diffusion = LatticeDiffusion::New(nsm);
+		diffusion->add_species(A);
+		diffusion->add_species(B);
+		operators.push_back(diffusion.get());
+	} else {
+		nsm.add_diffusion(A);
+		nsm.add_diffusion(B);
+	}
+	nsm.add_reaction(1.0,A>>B);
+	nsm.add_reaction(1.0,B>>A);
+	operators.push_back(&nsm);
+	nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(L/2,L,L),1000*grid.size());
+
+	boost::timer::cpu_timer timer;
+	operators.integrate_for_time(100*dt,dt);
+	const double seconds = timer.elapsed().wall/1.0e9;
+
+	double left = 0;
+	for (int i = 0; i < grid.size(); ++i) {
+		if (grid.get_cell_centre(i)[0] < L/2) left += A.copy_numbers[i] + B.copy_numbers[i];
+	}
+	const unsigned long jumps = lattice ? diffusion->get_number_of_jumps() : nsm.get_number_of_events();
+	std::cout << (lattice ? "lattice" : "nsm") << "\t" << seconds << "\t" << jumps/seconds << "\t"
+			<< left/(1000*grid.size()) << std::endl;
+}
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 16;
+	std::cout << "grid " << n << "^3" << std::endl;
+	std::cout << "diffusion\ttime (s)\tevents (nsm) or jumps (lattice) per s\tfraction in left half" << std::endl;
+	run(n,false);
+	run(n,true);
+	return 0;
+}
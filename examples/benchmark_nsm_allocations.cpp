@@ -0,0 +1,61 @@
+/*
+ * benchmark_nsm_allocations.cpp
+ *
+ * Counts the heap allocations made by the Next Subvolume Method while firing
+ * events, for a reaction-diffusion system on a 20^3 grid. With the indexed
+ * heap the event loop should not allocate at all once warmed up.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include "benchmark_allocations.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+void run(const bool use_indexed_heap) {
+	random_seed(1);
+	const int n = 20;
+	const double L = 1.0;
+	const double h = L/n;
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(use_indexed_heap);
+	nsm.set_propensity_sum_tree(true);
+	Species A(1.0),B(1.0);
+	nsm.add_diffusion(A);
+	nsm.add_diffusion(B);
+	nsm.add_reaction(1.0,A+A>>B);
+	nsm.add_reaction(0.5,B>>A+A);
+	nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(L,L,L),10*grid.size());
+
+	const double dt = 0.1*h*h;
+
+	/*
+	 * warm up, so that the dependency graph, the stoichiometry tables and
+	 * the event queue have reached their final size
+	 */
+	for (int i = 0; i < 100; ++i) nsm(dt);
+
+	const unsigned long events_before = nsm.get_number_of_events();
+	const unsigned long allocations_before = number_of_allocations;
+	boost::timer::cpu_timer timer;
+	for (int i = 0; i < 1000; ++i) nsm(dt);
+	const double seconds = timer.elapsed().wall/1.0e9;
+	const unsigned long events = nsm.get_number_of_events() - events_before;
+	const unsigned long allocations = number_of_allocations - allocations_before;
+
+	std::cout << (use_indexed_heap ? "indexed heap" : "pairing heap") << "\t"
+			<< events << "\t" << events/seconds << "\t" << allocations << "\t"
+			<< double(allocations)/events << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::cout << "queue\tevents\tevents/s\tallocations\tallocations/event" << std::endl;
+	run(false);
+	run(true);
+	return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * benchmark_nsm_memory.cpp
+ *
+ * Measures the heap used by the reactions of the Next Subvolume Method on an
+ * n^3 grid (n = 64 by default, or the first argument) with 20 diffusing
+ * species, a reaction network over all of them and an extra reaction in
+ * part of the domain. Subvolumes with the same reactions share them, so the
+ * memory per subvolume should be a small multiple of the number of
+ * reaction channels.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include "benchmark_allocations.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 64;
+	const int number_of_species = 20;
+	const double L = 1.0;
+	const double h = L/n;
+
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	std::vector<Species*> species;
+	for (int i = 0; i < number_of_species; ++i) {
+		species.push_back(new Species(1.0));
+	}
+
+	const long heap_before = heap_bytes;
+	boost::timer::cpu_timer timer;
+	NextSubvolumeMethod nsm(grid);
+	for (int i = 0; i < number_of_species; ++i) {
+		nsm.add_diffusion(*species[i]);
+	}
+	for (int i = 0; i+1 < number_of_species; i += 2) {
+		nsm.add_reaction(1.0,*species[i]+*species[i+1]>>*species[(i+2)%number_of_species]);
+		nsm.add_reaction(0.1,*species[(i+2)%number_of_species]>>*species[i]+*species[i+1]);
+	}
+	Box region(Vect3d(0,0,0),Vect3d(0.5*L,0.5*L,0.5*L),true);
+	nsm.add_reaction_in(1.0,*species[0]>>*species[1],region);
+	nsm.fill_uniform(*species[0],Vect3d(0,0,0),Vect3d(L,L,L),grid.size());
+	nsm(0.1*h*h);
+	const double seconds = timer.elapsed().wall/1.0e9;
+	const long bytes = heap_bytes - heap_before;
+
+	std::cout << "grid\t" << n << "^3 (" << grid.size() << " subvolumes)" << std::endl;
+	std::cout << "setup time (s)\t" << seconds << std::endl;
+	std::cout << "shared reaction templates\t" << nsm.get_number_of_reaction_templates() << std::endl;
+	std::cout << "heap (MB)\t" << bytes/1.0e6 << std::endl;
+	std::cout << "heap per subvolume (bytes)\t" << double(bytes)/grid.size() << std::endl;
+	return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * benchmark_nsm_startup.cpp
+ *
+ * Time from constructing the Next Subvolume Method to its first event on an
+ * n^3 grid (n = 64 by default, or the first argument) with 20 diffusing
+ * species and a reaction network over all of them, installing the
+ * diffusion and reactions one call per species or reaction, or in one
+ * batch each.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+void run(const int n, const bool batch) {
+	random_seed(1);
+	const int number_of_species = 20;
+	const double L = 1.0;
+	const double h = L/n;
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	std::vector<Species*> species;
+	for (int i = 0; i < number_of_species; ++i) {
+		species.push_back(new Species(1.0));
+	}
+	std::vector<double> rates;
+	std::vector<ReactionEquation> equations;
+	for (int i = 0; i+1 < number_of_species; i += 2) {
+		rates.push_back(1.0);
+		equations.push_back(*species[i]+*species[i+1]>>*species[(i+2)%number_of_species]);
+		rates.push_back(0.1);
+		equations.push_back(*species[(i+2)%number_of_species]>>*species[i]+*species[i+1]);
+	}
+
+	boost::timer::cpu_timer timer;
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(true);
+	if (batch) {
+		nsm.add_diffusion(species);
+		nsm.add_reactions(rates,equations);
+	} else {
+		for (int i = 0; i < number_of_species; ++i) {
+			nsm.add_diffusion(*species[i]);
+		}
+		for (unsigned int i = 0; i < rates.size(); ++i) {
+			nsm.add_reaction(rates[i],equations[i]);
+		}
+	}
+	const double setup_seconds = timer.elapsed().wall/1.0e9;
+
+	nsm.fill_uniform(*species[0],Vect3d(0,0,0),Vect3d(L,L,L),grid.size());
+	nsm(0);
+	while (nsm.get_number_of_events() == 0) {
+		nsm(1.0e-3*h*h);
+	}
+	const double first_event_seconds = timer.elapsed().wall/1.0e9;
+
+	std::cout << (batch ? "batch" : "per call") << "\t" << setup_seconds << "\t" << first_event_seconds << std::endl;
+	for (int i = 0; i < number_of_species; ++i) {
+		delete species[i];
+	}
+}
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 64;
+	std::cout << "grid " << n << "^3" << std::endl;
+	std::cout << "installation\tsetup time (s)\ttime to first event (s)" << std::endl;
+	run(n,false);
+	run(n,true);
+	return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * benchmark_parallel_molecules.cpp
+ *
+ * Molecules per second stepped by Diffusion followed by a jump and a
+ * reflective boundary, on 1, 2, 4, ... up to the number of OpenMP
+ * threads, for n molecules (10^6 by default, or the first argument). The
+ * checksum of the positions is the same for every number of threads.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Tyche;
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 1000000;
+	const int number_of_steps = 20;
+	const double dt = 1.0e-3;
+	std::cout << n << " molecules" << std::endl;
+	std::cout << "threads\tmolecules per second\tchecksum" << std::endl;
+
+	int max_threads = 1;
+#ifdef _OPENMP
+	max_threads = omp_get_max_threads();
+#endif
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		random_seed(1);
+		Species A(1.0);
+		A.mols.fill_uniform(Vect3d(0,0,0),Vect3d(1,1,1),n);
+		Diffusion diffusion;
+		diffusion.set_number_of_threads(threads);
+		diffusion.add_species(A);
+		xplane low(0,1);
+		xplane high(1,-1);
+		JumpBoundary<xplane> jump(low,Vect3d(1,0,0));
+		jump.set_number_of_threads(threads);
+		jump.add_species(A);
+		ReflectiveBoundary<xplane> reflect(high);
+		reflect.set_number_of_threads(threads);
+		reflect.add_species(A);
+
+		boost::timer::cpu_timer timer;
+		for (int i = 0; i < number_of_steps; ++i) {
+			diffusion(dt);
+			jump(dt);
+			reflect(dt);
+		}
+		const double seconds = timer.elapsed().wall/1.0e9;
+		double checksum = 0;
+		for (int i = 0; i < n; ++i) {
+			checksum += A.mols.r[i].sum();
+		}
+		std::cout << threads << "\t" << double(n)*number_of_steps/seconds << "\t" << checksum << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * benchmark_parallel_nsm.cpp
+ *
+ * Statistical check and strong scaling of the parallel NSM for diffusion
+ * with reversible dimerisation. First runs an 8x4x4 grid many times (400
+ * by default, or the first argument) with the serial NSM and with 4
+ * subdomains, and compares the mean and variance of the final copy
+ * numbers. The two sample the same process, so the z scores should mostly
+ * lie within +-2. Then times a 64x16x16 grid against the serial NSM, each
+ * run using as many subdomains as threads.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include "benchmark_statistics.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Tyche;
+
+template<typename T>
+double run(T& nsm, double& monomers, double& dimers, const int seed = 1, const double end_time = 0.05) {
+	random_seed(seed);
+	const Grid& grid = nsm.get_grid();
+	Species A(1.0),B(0.1);
+	nsm.add_diffusion(A);
+	nsm.add_diffusion(B);
+	nsm.add_reaction(1.0e-2,A+A>>B);
+	nsm.add_reaction(1.0,B>>A+A);
+	nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(2,1,1),10*grid.size());
+
+	boost::timer::cpu_timer timer;
+	nsm.integrate_for_time(end_time,0.01);
+	const double seconds = timer.elapsed().wall/1.0e9;
+
+	monomers = 0;
+	dimers = 0;
+	for (int i = 0; i < grid.size(); ++i) {
+		monomers += A.copy_numbers[i];
+		dimers += B.copy_numbers[i];
+	}
+	monomers /= grid.size();
+	dimers /= grid.size();
+	return seconds;
+}
+
+int main(int argc, char **argv) {
+	const int runs = argc > 1 ? atoi(argv[1]) : 400;
+	Moments monomer_moments[2],dimer_moments[2];
+	for (int r = 0; r < runs; ++r) {
+		for (int parallel = 0; parallel < 2; ++parallel) {
+			StructuredGrid grid(Vect3d(0,0,0),Vect3d(2,1,1),Vect3d(0.25,0.25,0.25));
+			double a,b;
+			if (parallel) {
+				ParallelNextSubvolumeMethod pnsm(grid);
+				pnsm.set_number_of_subdomains(4);
+				run(pnsm,a,b,r+1,0.5);
+			} else {
+				NextSubvolumeMethod nsm(grid);
+				nsm.set_indexed_heap(true);
+				run(nsm,a,b,r+1,0.5);
+			}
+			monomer_moments[parallel].add(a);
+			dimer_moments[parallel].add(b);
+		}
+	}
+	std::cout << "species\tmean (serial)\tmean (parallel)\tz\tvariance (serial)\tvariance (parallel)\tz" << std::endl;
+	std::cout << "A\t" << monomer_moments[0].mean() << "\t" << monomer_moments[1].mean() << "\t" << z_mean(monomer_moments[0],monomer_moments[1]) << "\t"
+			<< monomer_moments[0].variance() << "\t" << monomer_moments[1].variance() << "\t" << z_variance(monomer_moments[0],monomer_moments[1]) << std::endl;
+	std::cout << "B\t" << dimer_moments[0].mean() << "\t" << dimer_moments[1].mean() << "\t" << z_mean(dimer_moments[0],dimer_moments[1]) << "\t"
+			<< dimer_moments[0].variance() << "\t" << dimer_moments[1].variance() << "\t" << z_variance(dimer_moments[0],dimer_moments[1]) << std::endl << std::endl;
+
+	const double h = 1.0/16;
+	const Vect3d low(0,0,0),high(4,1,1),spacing(h,h,h);
+	std::cout << "threads\ttime (s)\tevents/s\tspeedup\tefficiency\ttransfers\trollbacks\tA per cell\tB per cell" << std::endl;
+
+	StructuredGrid serial_grid(low,high,spacing);
+	NextSubvolumeMethod nsm(serial_grid);
+	nsm.set_indexed_heap(true);
+	double monomers,dimers;
+	const double serial_time = run(nsm,monomers,dimers);
+	std::cout << "serial\t" << serial_time << "\t" << nsm.get_number_of_events()/serial_time << "\t1\t1\t0\t0\t"
+			<< monomers << "\t" << dimers << std::endl;
+
+	int max_threads = 1;
+#ifdef _OPENMP
+	max_threads = omp_get_num_procs();
+#endif
+	for (int threads = 1; threads <= 64; threads *= 2) {
+		if (threads > 2*max_threads) break;
+#ifdef _OPENMP
+		omp_set_num_threads(threads);
+#endif
+		StructuredGrid grid(low,high,spacing);
+		ParallelNextSubvolumeMethod pnsm(grid);
+		pnsm.set_number_of_subdomains(threads);
+		const double time = run(pnsm,monomers,dimers);
+		const double speedup = serial_time/time;
+		std::cout << threads << "\t" << time << "\t" << pnsm.get_number_of_events()/time << "\t"
+				<< speedup << "\t" << speedup/threads << "\t" << pnsm.get_number_of_transfers() << "\t"
+				<< pnsm.get_number_of_rollbacks() << "\t" << monomers << "\t" << dimers << std::endl;
+	}
+	return 0;
+}
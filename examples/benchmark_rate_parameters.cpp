@@ -0,0 +1,68 @@
+/*
+ * benchmark_rate_parameters.cpp
+ *
+ * Cost of changing a rate mid-run on an n^3 grid (n = 64 by default, or
+ * the first argument) with three species diffusing and reacting
+ * everywhere, and a production reaction in a box holding 1/64 of the
+ * domain whose rate is a RateParameter. Setting the parameter only
+ * refreshes the subvolumes in the box, where before a rate change needed
+ * at least a full reset of the priorities.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 64;
+	const double L = 1.0;
+	const double h = L/n;
+	const int number_of_changes = 100;
+	random_seed(1);
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	Species A(1.0e-3),B(1.0e-3),C(1.0e-3);
+	RateParameter k(100.0);
+
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(true);
+	nsm.set_time_rescaling(true);
+	std::vector<Species*> species;
+	species.push_back(&A);
+	species.push_back(&B);
+	species.push_back(&C);
+	nsm.add_diffusion(species);
+	nsm.add_reaction(1.0,A+B>>C);
+	nsm.add_reaction(0.1,C>>A+B);
+	Box box(Vect3d(0,0,0),Vect3d(L/4,L/4,L/4),true);
+	nsm.add_reaction_in(k,0>>A,box);
+	nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(L,L,L),grid.size());
+	nsm.fill_uniform(B,Vect3d(0,0,0),Vect3d(L,L,L),grid.size());
+	nsm(0);
+	const double dt = 1.0e-6;
+
+	boost::timer::cpu_timer parameter_timer;
+	for (int i = 0; i < number_of_changes; ++i) {
+		k.set_value(100.0*(1 + i%2));
+		nsm(dt);
+	}
+	const double parameter_seconds = parameter_timer.elapsed().wall/1.0e9/number_of_changes;
+
+	boost::timer::cpu_timer reset_timer;
+	for (int i = 0; i < number_of_changes; ++i) {
+		nsm.reset_all_priorities();
+		nsm(dt);
+	}
+	const double reset_seconds = reset_timer.elapsed().wall/1.0e9/number_of_changes;
+
+	std::cout << "grid " << n << "^3, " << grid.size()/64 << " subvolumes using the parameter" << std::endl;
+	std::cout << "update\ttime per rate change (s)" << std::endl;
+	std::cout << "rate parameter\t" << parameter_seconds << std::endl;
+	std::cout << "full reset\t" << reset_seconds << std::endl;
+	std::cout << "speedup\t" << reset_seconds/parameter_seconds << std::endl;
+	return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * benchmark_sparse_nsm.cpp
+ *
+ * Heap use, reset time and event rate of the dense and sparse NSM on an
+ * n^3 grid (n = 96 by default, or the first argument) with 10 diffusing
+ * and reacting species, whose molecules start in a corner holding 1/512 of
+ * the domain, like a front about to spread into empty space.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include "benchmark_allocations.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+void run(const int n, const bool sparse) {
+	random_seed(1);
+	const int number_of_species = 10;
+	const double L = 1.0;
+	const double h = L/n;
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	std::vector<Species*> species;
+	for (int i = 0; i < number_of_species; ++i) {
+		species.push_back(new Species(1.0e-3));
+	}
+
+	const long heap_before = heap_bytes;
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(true);
+	nsm.set_sparse(sparse);
+	for (int i = 0; i < number_of_species; ++i) {
+		nsm.add_diffusion(*species[i]);
+	}
+	for (int i = 0; i+1 < number_of_species; i += 2) {
+		nsm.add_reaction(1.0,*species[i]+*species[i+1]>>*species[(i+2)%number_of_species]);
+		nsm.add_reaction(0.1,*species[(i+2)%number_of_species]>>*species[i]+*species[i+1]);
+	}
+	const Vect3d corner(L/8,L/8,L/8);
+	for (int i = 0; i < number_of_species; ++i) {
+		nsm.fill_uniform(*species[i],Vect3d(0,0,0),corner,10*grid.size()/512);
+	}
+	nsm(0);
+
+	boost::timer::cpu_timer reset_timer;
+	nsm.reset();
+	const double reset_seconds = reset_timer.elapsed().wall/1.0e9;
+
+	boost::timer::cpu_timer timer;
+	nsm(0.1);
+	const double seconds = timer.elapsed().wall/1.0e9;
+	const long bytes = heap_bytes - heap_before;
+
+	std::cout << (sparse ? "sparse" : "dense") << "\t" << bytes/1.0e6 << "\t" << double(bytes)/grid.size() << "\t"
+			<< reset_seconds << "\t" << nsm.get_number_of_events()/seconds << std::endl;
+	for (int i = 0; i < number_of_species; ++i) {
+		delete species[i];
+	}
+}
+
+int main(int argc, char **argv) {
+	const int n = argc > 1 ? atoi(argv[1]) : 96;
+	std::cout << "grid " << n << "^3" << std::endl;
+	std::cout << "mode\theap (MB)\theap per subvolume (bytes)\treset time (s)\tevents/s" << std::endl;
+	run(n,false);
+	run(n,true);
+	return 0;
+}
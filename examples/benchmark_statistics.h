@@ -0,0 +1,40 @@
+/*
+ * benchmark_statistics.h
+ *
+ * Moments of repeated runs, and z scores comparing two sets of runs, for
+ * the benchmarks that check one method statistically against another.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef BENCHMARK_STATISTICS_H_
+#define BENCHMARK_STATISTICS_H_
+
+#include <cmath>
+
+struct Moments {
+	Moments():n(0),sum(0),sum_sq(0) {}
+	void add(const double x) {
+		n++;
+		sum += x;
+		sum_sq += x*x;
+	}
+	double mean() const { return sum/n; }
+	double variance() const { return (sum_sq - sum*sum/n)/(n-1); }
+	int n;
+	double sum,sum_sq;
+};
+
+/*
+ * z score of the difference of the means, and of the variances using the
+ * normal approximation var(s^2) ~ 2 s^4/(n-1)
+ */
+inline double z_mean(const Moments& a, const Moments& b) {
+	return (a.mean()-b.mean())/std::sqrt(a.variance()/a.n + b.variance()/b.n);
+}
+inline double z_variance(const Moments& a, const Moments& b) {
+	const double va = a.variance(), vb = b.variance();
+	return (va-vb)/std::sqrt(2*va*va/(a.n-1) + 2*vb*vb/(b.n-1));
+}
+
+#endif /* BENCHMARK_STATISTICS_H_ */
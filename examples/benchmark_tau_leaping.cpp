@@ -0,0 +1,68 @@
+/*
+ * benchmark_tau_leaping.cpp
+ *
+ * Compares the wall time of exact NSM and tau-leaping for diffusion with
+ * reversible dimerisation on a 10^3 grid holding 10^4 molecules per cell,
+ * for several values of the error control parameter epsilon.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include <boost/timer/timer.hpp>
+#include <iostream>
+
+using namespace Tyche;
+
+template<typename T>
+double run(T& nsm, double& fraction_left, double& dimers) {
+	random_seed(1);
+	const Grid& grid = nsm.get_grid();
+	Species A(1.0),B(0.1);
+	nsm.add_diffusion(A);
+	nsm.add_diffusion(B);
+	nsm.add_reaction(1.0e-7,A+A>>B);
+	nsm.add_reaction(1.0,B>>A+A);
+	nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(0.5,1,1),10000*grid.size());
+
+	boost::timer::cpu_timer timer;
+	nsm.integrate_for_time(0.005,0.001);
+	const double seconds = timer.elapsed().wall/1.0e9;
+
+	double total = 0;
+	fraction_left = 0;
+	dimers = 0;
+	for (int i = 0; i < grid.size(); ++i) {
+		total += A.copy_numbers[i];
+		dimers += B.copy_numbers[i];
+		if (grid.get_cell_centre(i)[0] < 0.5) fraction_left += A.copy_numbers[i];
+	}
+	fraction_left /= total;
+	dimers /= grid.size();
+	return seconds;
+}
+
+int main(int argc, char **argv) {
+	const double L = 1.0;
+	const double h = L/10;
+	std::cout << "method\tepsilon\ttime (s)\tspeedup\tevents\tA in left half\tB per cell" << std::endl;
+
+	StructuredGrid exact_grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+	NextSubvolumeMethod nsm(exact_grid);
+	nsm.set_indexed_heap(true);
+	double fraction_left,dimers;
+	const double exact_time = run(nsm,fraction_left,dimers);
+	std::cout << "nsm\t-\t" << exact_time << "\t1\t" << nsm.get_number_of_events() << "\t"
+			<< fraction_left << "\t" << dimers << std::endl;
+
+	const double epsilons[] = {0.01, 0.03, 0.1};
+	for (double epsilon : epsilons) {
+		StructuredGrid grid(Vect3d(0,0,0),Vect3d(L,L,L),Vect3d(h,h,h));
+		TauLeaping tau(grid);
+		tau.set_epsilon(epsilon);
+		const double tau_time = run(tau,fraction_left,dimers);
+		std::cout << "tau\t" << epsilon << "\t" << tau_time << "\t" << exact_time/tau_time << "\t"
+				<< tau.get_number_of_events() << "\t" << fraction_left << "\t" << dimers << std::endl;
+	}
+	return 0;
+}
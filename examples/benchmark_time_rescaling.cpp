@@ -0,0 +1,114 @@
+/*
+ * benchmark_time_rescaling.cpp
+ *
+ * Statistical check and timing of the Next Reaction Method time rescaling
+ * in the NSM. Runs diffusion with production, decay and reversible
+ * dimerisation of A on a 4^3 grid many times with and without rescaling,
+ * and compares the mean and variance of the final copy numbers. The two
+ * methods sample the same process, so the z scores of the differences
+ * should mostly lie within +-2.
+ *
+ * Then times each method twice. In the longer run of the same model each
+ * event reschedules at most one subvolume besides the one that fired, so
+ * rescaling saves at most one uniform and one log per event, which is
+ * within the timing noise. In the second timing a rate parameter used by
+ * every subvolume of a 32^3 grid changes before each short step, so every
+ * subvolume is rescheduled at once and the saved draws show up, if at
+ * all, in the time per change.
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "Tyche.h"
+#include "benchmark_statistics.h"
+#include <boost/timer/timer.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace Tyche;
+
+double run(const bool rescale, const int seed, const double end_time, double& monomers, double& dimers, unsigned long& events) {
+	random_seed(seed);
+	const double h = 1.0/4;
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(1,1,1),Vect3d(h,h,h));
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(true);
+	nsm.set_time_rescaling(rescale);
+	Species A(0.1),B(0.01);
+	nsm.add_diffusion(A);
+	nsm.add_diffusion(B);
+	nsm.add_reaction(200.0,0>>A);
+	nsm.add_reaction(1.0,A>>0);
+	nsm.add_reaction(0.01,A+A>>B);
+	nsm.add_reaction(1.0,B>>A+A);
+
+	boost::timer::cpu_timer timer;
+	nsm.integrate_for_time(end_time,end_time);
+	const double seconds = timer.elapsed().wall/1.0e9;
+
+	monomers = 0;
+	dimers = 0;
+	for (int i = 0; i < grid.size(); ++i) {
+		monomers += A.copy_numbers[i];
+		dimers += B.copy_numbers[i];
+	}
+	events = nsm.get_number_of_events();
+	return seconds;
+}
+
+double time_rate_changes(const bool rescale) {
+	random_seed(1);
+	const int n = 32;
+	const double h = 1.0/n;
+	const int number_of_changes = 1000;
+	StructuredGrid grid(Vect3d(0,0,0),Vect3d(1,1,1),Vect3d(h,h,h));
+	NextSubvolumeMethod nsm(grid);
+	nsm.set_indexed_heap(true);
+	nsm.set_time_rescaling(rescale);
+	Species A(0);
+	RateParameter k(1.0);
+	nsm.add_species(A);
+	nsm.add_reaction(k,A>>0);
+	nsm.fill_uniform(A,Vect3d(0,0,0),Vect3d(1,1,1),100*grid.size());
+	nsm(0);
+
+	boost::timer::cpu_timer timer;
+	for (int i = 0; i < number_of_changes; ++i) {
+		k.set_value(1.0 + i%2);
+		nsm(1.0e-6);
+	}
+	return timer.elapsed().wall/1.0e9/number_of_changes;
+}
+
+int main(int argc, char **argv) {
+	const int runs = argc > 1 ? atoi(argv[1]) : 400;
+	Moments monomers[2],dimers[2];
+	for (int r = 0; r < runs; ++r) {
+		for (int rescale = 0; rescale < 2; ++rescale) {
+			double a,b;
+			unsigned long events;
+			run(rescale,r+1,2.0,a,b,events);
+			monomers[rescale].add(a);
+			dimers[rescale].add(b);
+		}
+	}
+	std::cout << "species\tmean (resample)\tmean (rescale)\tz\tvariance (resample)\tvariance (rescale)\tz" << std::endl;
+	std::cout << "A\t" << monomers[0].mean() << "\t" << monomers[1].mean() << "\t" << z_mean(monomers[0],monomers[1]) << "\t"
+			<< monomers[0].variance() << "\t" << monomers[1].variance() << "\t" << z_variance(monomers[0],monomers[1]) << std::endl;
+	std::cout << "B\t" << dimers[0].mean() << "\t" << dimers[1].mean() << "\t" << z_mean(dimers[0],dimers[1]) << "\t"
+			<< dimers[0].variance() << "\t" << dimers[1].variance() << "\t" << z_variance(dimers[0],dimers[1]) << std::endl;
+
+	std::cout << std::endl << "method\ttime (s)\tevents/s" << std::endl;
+	for (int rescale = 0; rescale < 2; ++rescale) {
+		double a,b;
+		unsigned long events;
+		const double seconds = run(rescale,1,1000.0,a,b,events);
+		std::cout << (rescale ? "rescale" : "resample") << "\t" << seconds << "\t" << events/seconds << std::endl;
+	}
+
+	std::cout << std::endl << "method	time per rate change rescheduling 32^3 subvolumes (s)" << std::endl;
+	for (int rescale = 0; rescale < 2; ++rescale) {
+		std::cout << (rescale ? "rescale" : "resample") << "\t" << time_rate_changes(rescale) << std::endl;
+	}
+	return 0;
+}
@@ -200,6 +200,7 @@ BOOST_PYTHON_FUNCTION_OVERLOADS(new_bi_reaction_overloads2, new_bi_reaction2, 6,
 
 
 boost::python::numeric::array Species_get_compartments(Species& self) {
+  self.synchronise();
   if (self.grid!=NULL) {
     Vect3i grid_size = self.grid->get_cells_along_axes();
     npy_intp size[3] = {grid_size[0],grid_size[1],grid_size[2]};
@@ -236,6 +237,7 @@ boost::python::numeric::array Species_get_compartments(Species& self) {
 
 void Species_set_compartments(Species& self,boost::python::numeric::array array) {
 	PyObject *in = array.ptr();
+	self.synchronise();
 	if (self.grid!=NULL) {
 		Vect3i grid_size = self.grid->get_cells_along_axes();
 		npy_intp size[3] = {grid_size[0],grid_size[1],grid_size[2]};
@@ -349,6 +351,7 @@ boost::python::list OctreeGrid_get_concentration(OctreeGrid& self, Species& s)
 {
   std::vector<Octree*> cells = self.get_cells();
   boost::python::list ret;
+  s.synchronise();
   for (int i = 0; i < cells.size(); i++)
     ret.append(s.copy_numbers[i]/self.get_cell_volume(i));
   return ret;
@@ -437,8 +440,75 @@ void* extract_vtk_wrapped_pointer(PyObject* obj)
     converter::registry::insert(&extract_vtk_wrapped_pointer, type_id<type>());
 
 
+void NSM_add_diffusion_list(NextSubvolumeMethod& self, const boost::python::list& species) {
+	std::vector<Species*> all_species;
+	const int n = len(species);
+	for (int i = 0; i < n; ++i) {
+		all_species.push_back(extract<Species*>(species[i]));
+	}
+	self.add_diffusion(all_species);
+}
+
+void NSM_add_reactions(NextSubvolumeMethod& self, const boost::python::list& rates, const boost::python::list& equations) {
+	std::vector<double> all_rates;
+	std::vector<ReactionEquation> all_equations;
+	const int n = len(rates);
+	for (int i = 0; i < n; ++i) {
+		all_rates.push_back(extract<double>(rates[i]));
+		all_equations.push_back(extract<ReactionEquation>(equations[i]));
+	}
+	self.add_reactions(all_rates,all_equations);
+}
+
+boost::python::numeric::array NSM_counts_to_array(NextSubvolumeMethod& self, const std::vector<unsigned long>& counts) {
+	const Grid& grid = self.get_grid();
+	Vect3i grid_size = grid.get_cells_along_axes();
+	npy_intp size[3] = {grid_size[0],grid_size[1],grid_size[2]};
+	PyObject *out = PyArray_SimpleNew(3, size, NPY_ULONG);
+	const StructuredGrid *sgrid = dynamic_cast<const StructuredGrid*>(&grid);
+	const OctreeGrid *ogrid = dynamic_cast<const OctreeGrid*>(&grid);
+	for (int i = 0; i < grid_size[0]; ++i) {
+		for (int j = 0; j < grid_size[1]; ++j) {
+			for (int k = 0; k < grid_size[2]; ++k) {
+				unsigned long num = 0;
+				if (sgrid!=NULL) {
+					num = counts[sgrid->vect_to_index(i,j,k)];
+				} else {
+					for (auto ind : ogrid->get_leaf_indices(Vect3i(i,j,k)))
+						num += counts[ind];
+				}
+				*((unsigned long *)PyArray_GETPTR3(out, i, j, k)) = num;
+			}
+		}
+	}
+	boost::python::handle<> handle(out);
+	boost::python::numeric::array arr(handle);
+	return arr;
+}
+
+boost::python::numeric::array NSM_get_activity(NextSubvolumeMethod& self, const ReactionList::ChannelType type) {
+	return NSM_counts_to_array(self,self.get_activity(type));
+}
+
+boost::python::numeric::array NSM_get_species_activity(NextSubvolumeMethod& self, const Species& s) {
+	return NSM_counts_to_array(self,self.get_activity(s));
+}
+
 std::auto_ptr<NextSubvolumeMethod> (*NSM_New1)(const Vect3d&, const Vect3d&, const Vect3d&) = &NextSubvolumeMethod::New;
 std::auto_ptr<NextSubvolumeMethod> (*NSM_New2)(Grid&) = &NextSubvolumeMethod::New;
+std::auto_ptr<TauLeaping> (*TauLeaping_New1)(const Vect3d&, const Vect3d&, const Vect3d&) = &TauLeaping::New;
+std::auto_ptr<TauLeaping> (*TauLeaping_New2)(Grid&) = &TauLeaping::New;
+std::auto_ptr<ParallelNextSubvolumeMethod> (*ParallelNSM_New1)(const Vect3d&, const Vect3d&, const Vect3d&) = &ParallelNextSubvolumeMethod::New;
+std::auto_ptr<ParallelNextSubvolumeMethod> (*ParallelNSM_New2)(Grid&) = &ParallelNextSubvolumeMethod::New;
+std::auto_ptr<CompositionRejection> (*CompositionRejection_New1)(const Vect3d&, const Vect3d&, const Vect3d&) = &CompositionRejection::New;
+std::auto_ptr<CompositionRejection> (*CompositionRejection_New2)(Grid&) = &CompositionRejection::New;
+std::auto_ptr<LatticeDiffusion> (*LatticeDiffusion_New1)(Grid&) = &LatticeDiffusion::New;
+std::auto_ptr<LatticeDiffusion> (*LatticeDiffusion_New2)(NextSubvolumeMethod&) = &LatticeDiffusion::New;
+void (NextSubvolumeMethod::*NSM_add_diffusion)(Species&) = &NextSubvolumeMethod::add_diffusion;
+void (NextSubvolumeMethod::*NSM_add_reaction)(const double, ReactionEquation) = &NextSubvolumeMethod::add_reaction;
+void (NextSubvolumeMethod::*NSM_add_reaction_with_parameter)(RateParameter&, ReactionEquation) = &NextSubvolumeMethod::add_reaction;
+void (NextSubvolumeMethod::*NSM_add_reaction_on)(const double, ReactionEquation, const Geometry&) = &NextSubvolumeMethod::add_reaction_on;
+void (NextSubvolumeMethod::*NSM_add_reaction_on_with_parameter)(RateParameter&, ReactionEquation, const Geometry&) = &NextSubvolumeMethod::add_reaction_on;
 void (NextSubvolumeMethod::*NSM_add_diffusion_between)(Species&, const double, Geometry&, Geometry&) = &NextSubvolumeMethod::add_diffusion_between;
 void (NextSubvolumeMethod::*NSM_scale_diffusion_across)(Species&, Geometry&, const double) = &NextSubvolumeMethod::scale_diffusion_across;
 
@@ -491,6 +561,17 @@ BOOST_PYTHON_MODULE(pyTyche) {
 	def("new_species",Species_New_double);
 	def("new_species",Species_New_Vect3d);
 
+	/*
+	 * RateParameter
+	 */
+
+	class_<RateParameter,typename std::auto_ptr<RateParameter> >("RateParameter",boost::python::init<double>())
+			.def("get_value",&RateParameter::get_value)
+			.def("set_value",&RateParameter::set_value,args("value"),
+					"Sets the rate of all the reactions added with this parameter. Operators using it refresh the propensities of the affected compartments at their next step")
+			;
+	def("new_rate_parameter",&RateParameter::New);
+
 
    /*
     * Operator
@@ -637,14 +718,126 @@ BOOST_PYTHON_MODULE(pyTyche) {
     	.def("set_interface",&NextSubvolumeMethod::set_interface)
     	.def("unset_interface",&NextSubvolumeMethod::unset_interface)
     	.def("set_ghost_cell_interface",&NextSubvolumeMethod::set_ghost_cell_interface)
-    	.def("add_diffusion",&NextSubvolumeMethod::add_diffusion)
+    	.def("add_diffusion",NSM_add_diffusion)
+    	.def("add_diffusion",NSM_add_diffusion_list,
+    			"add the diffusion of a list of species in one pass over the grid")
     	.def("add_diffusion_between",NSM_add_diffusion_between)
-    	.def("add_reaction",&NextSubvolumeMethod::add_reaction)
-    	.def("add_reaction_on",&NextSubvolumeMethod::add_reaction_on)
+    	.def("add_reaction",NSM_add_reaction)
+    	.def("add_reaction",NSM_add_reaction_with_parameter,
+    			"add a reaction whose rate is the current value of a RateParameter")
+    	.def("add_reactions",NSM_add_reactions,args("rates","equations"),
+    			"add a list of reactions (with a list of their rates) in one pass over the grid")
+    	.def("add_reaction_on",NSM_add_reaction_on)
+    	.def("add_reaction_on",NSM_add_reaction_on_with_parameter)
     	.def("scale_diffusion_across",NSM_scale_diffusion_across)
     	.def("fill_uniform",&NextSubvolumeMethod::fill_uniform)
     	.def("reset_all_propensities",&NextSubvolumeMethod::reset_all_priorities,
     			"Recalculates the propensities and next reaction times for all compartments")
+    	.def("set_indexed_heap",&NextSubvolumeMethod::set_indexed_heap,args("use"),
+    			"Selects the event queue: a flat indexed 4-ary heap (True) or the boost pairing heap (False, default)")
+    	.def("set_propensity_sum_tree",&NextSubvolumeMethod::set_propensity_sum_tree,args("use"),
+    			"Selects reactions within each compartment using a Fenwick tree over the reaction propensities (O(log k) selection and update)")
+    	.def("set_sparse",&NextSubvolumeMethod::set_sparse,args("use"),
+    			"Stores propensities only for compartments that can react and looks up reaction dependencies through the shared reaction sets, for large, mostly empty domains")
+    	.def("set_narrow_copy_numbers",&NextSubvolumeMethod::set_narrow_copy_numbers,args("use"),
+    			"Stores copy numbers in 16 bit integers while they fit, switching to 32 bit when one doesn't. Returns whether they are 16 bit")
+    	.def("set_time_rescaling",&NextSubvolumeMethod::set_time_rescaling,args("use"),
+    			"When a compartment's propensity changes, rescale its next reaction time instead of drawing a new one (Next Reaction Method)")
+    	.def("get_number_of_events",&NextSubvolumeMethod::get_number_of_events,
+    			"Returns the total number of events executed so far")
+    	.def("get_number_of_reaction_templates",&NextSubvolumeMethod::get_number_of_reaction_templates,
+    			"Returns the number of distinct reaction sets shared between compartments")
+    	.def("set_activity_counters",&NextSubvolumeMethod::set_activity_counters,args("use"),
+    			"Count the events in each compartment, by channel type and by the species they consume (zeroes the counts)")
+    	.def("reset_activity_counters",&NextSubvolumeMethod::reset_activity_counters,
+    			"Zero the activity counters")
+    	.def("get_activity",NSM_get_activity,args("type"),
+    			"Returns the number of events of a ChannelType in each compartment, as a grid-shaped array")
+    	.def("get_activity",NSM_get_species_activity,args("species"),
+    			"Returns the number of events consuming a species in each compartment, as a grid-shaped array")
+    	.def("get_vtk_activity",&NextSubvolumeMethod::get_vtk_activity,
+    			"Returns the vtkUnstructuredGrid of the compartments with the activity counts as cell data")
+    	;
+
+    enum_<ReactionList::ChannelType>("ChannelType")
+    	.value("reaction",ReactionList::REACTION_CHANNEL)
+    	.value("diffusion",ReactionList::DIFFUSION_CHANNEL)
+    	.value("interface",ReactionList::INTERFACE_CHANNEL)
+    	;
+
+    /*
+     * Tau Leaping
+     */
+    def("new_tau_leaping",TauLeaping_New1);
+    def("new_tau_leaping",TauLeaping_New2);
+    class_<TauLeaping, bases<NextSubvolumeMethod>, std::auto_ptr<TauLeaping> >("TauLeaping",boost::python::no_init)
+    	.def("set_epsilon",&TauLeaping::set_epsilon,args("eps"),
+    			"Sets the error control parameter, the bound on the expected relative change of a copy number in one leap (default 0.03)")
+    	.def("set_critical_number",&TauLeaping::set_critical_number,args("n"),
+    			"Compartments with a reactant copy number below n are simulated exactly (default 10)")
+    	.def("set_langevin_threshold",&TauLeaping::set_langevin_threshold,args("n"),
+    			"Channels expected to fire more than n times in a leap use the Langevin (normal) approximation (default 100)")
+    	.def("get_number_of_leaps",&TauLeaping::get_number_of_leaps,
+    			"Returns the total number of leaps taken so far")
+    	;
+
+    /*
+     * Parallel Next Subvolume Method
+     */
+    def("new_parallel_compartments",ParallelNSM_New1);
+    def("new_parallel_compartments",ParallelNSM_New2);
+    class_<ParallelNextSubvolumeMethod, bases<NextSubvolumeMethod>, std::auto_ptr<ParallelNextSubvolumeMethod>, boost::noncopyable>("ParallelNextSubvolumeMethod",boost::python::no_init)
+    	.def("set_number_of_subdomains",&ParallelNextSubvolumeMethod::set_number_of_subdomains,args("n"),
+    			"Splits the grid into n slabs, each simulated by one thread (default 4)")
+    	.def("set_window",&ParallelNextSubvolumeMethod::set_window,args("dt"),
+    			"Sets the time between exchanges of molecules across subdomain boundaries (0 chooses it from the diffusion rates)")
+    	.def("get_number_of_transfers",&ParallelNextSubvolumeMethod::get_number_of_transfers,
+    			"Returns the total number of molecule transfers between subdomains so far")
+    	.def("set_asynchronous",&ParallelNextSubvolumeMethod::set_asynchronous,args("use"),
+    			"Run the interior compartments on their own thread, overlapping the operators after this one, and exchange molecules with the interface compartments once per timestep")
+    	.def("add_interface_region",&ParallelNextSubvolumeMethod::add_interface_region,args("geometry"),
+    			"Treat the compartments in geometry as interface compartments in asynchronous mode")
+    	.def("synchronise",&ParallelNextSubvolumeMethod::synchronise,
+    			"Wait for the interior compartments to finish their step, needed before reading their copy numbers")
+    	;
+
+    /*
+     * Composition-Rejection SSA
+     */
+    def("new_composition_rejection",CompositionRejection_New1);
+    def("new_composition_rejection",CompositionRejection_New2);
+    class_<CompositionRejection, bases<NextSubvolumeMethod>, std::auto_ptr<CompositionRejection> >("CompositionRejection",boost::python::no_init)
+    	.def("get_number_of_groups",&CompositionRejection::get_number_of_groups,
+    			"Returns the number of propensity groups in use")
+    	.def("get_number_of_rejections",&CompositionRejection::get_number_of_rejections,
+    			"Returns the total number of rejected subvolume picks so far")
+    	;
+
+    /*
+     * Multiparticle lattice diffusion
+     */
+    def("new_lattice_diffusion",LatticeDiffusion_New1);
+    def("new_lattice_diffusion",LatticeDiffusion_New2);
+    class_<LatticeDiffusion, bases<Operator>, std::auto_ptr<LatticeDiffusion> >("LatticeDiffusion",boost::python::no_init)
+    	.def("get_number_of_jumps",&LatticeDiffusion::get_number_of_jumps,
+    			"Returns the total number of molecule jumps so far")
+    	;
+
+    /*
+     * Deterministic (finite volume) regime
+     */
+    def("new_finite_volume_method",FiniteVolumeMethod::New);
+    class_<FiniteVolumeMethod, bases<Operator>, std::auto_ptr<FiniteVolumeMethod> >("FiniteVolumeMethod",boost::python::no_init)
+    	.def("add_reaction",&FiniteVolumeMethod::add_reaction,args("rate","equation"),
+    			"Adds a mass action reaction, with the same rate as for the compartments")
+    	.def("add_region",&FiniteVolumeMethod::add_region,args("geometry"),
+    			"Moves the compartments in geometry into the deterministic regime")
+    	.def("set_thresholds",&FiniteVolumeMethod::set_thresholds,args("to_pde","to_nsm"),
+    			"Compartments join the deterministic regime when they hold at least to_pde molecules, and leave it below to_nsm")
+    	.def("get_number_of_cells",&FiniteVolumeMethod::get_number_of_cells,
+    			"Returns the number of compartments in the deterministic regime")
+    	.def("get_number_of_solves",&FiniteVolumeMethod::get_number_of_solves,
+    			"Returns the total number of sparse solves so far")
     	;
 
 }
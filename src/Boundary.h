@@ -31,6 +31,7 @@
 #include "Operator.h"
 #include "Union.h"
 #include "NextSubvolumeMethod.h"
+#include "MoleculeBlocks.h"
 #include <iostream>
 
 namespace Tyche {
@@ -42,10 +43,19 @@ public:
 	}
 	const T& geometry;
 
+	/*
+	 * go through the molecules on n threads (JumpBoundary, RemoveBoundary
+	 * and ReflectiveBoundary), see MoleculeBlocks. The geometry must be
+	 * safe to query from several threads
+	 */
+	void set_number_of_threads(const int n) { blocks.set_number_of_threads(n); }
+	int get_number_of_threads() const { return blocks.get_number_of_threads(); }
+
 protected:
 	virtual void print(std::ostream& out) const  {
 		out << "\tBoundary at "<< this->geometry;
 	}
+	MoleculeBlocks blocks;
 };
 
 
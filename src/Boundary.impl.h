@@ -20,19 +20,30 @@ template<typename T>
 void JumpBoundary<T>::integrate(const double dt) {
 	BOOST_FOREACH(Species *s, this->get_species()) {
 		Molecules& mols = s->mols;
-		const int n = mols.size();
-		for (int i = 0; i < n; ++i) {
-//			if (this->geometry.lineXsurface(mols.r0[i],mols.r[i])) {
-//				mols.r[i] += jump_by;
-//				mols.r0[i] += jump_by;
-//				//mols.saved_index[i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
-//			}
-			while (this->geometry.distance_to_boundary(mols.r[i]) < 0) {
-				mols.r[i] += jump_by;
-				mols.r0[i] += jump_by;
-				//mols.saved_index[i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
+		const int nb = this->blocks.split(mols.size());
+		#pragma omp parallel for schedule(static) num_threads(this->blocks.get_number_of_threads()) if(this->blocks.is_parallel())
+		for (int b = 0; b < nb; ++b) {
+			std::vector<int>& moved = this->blocks.get_list(b);
+			const int end = this->blocks.end(b);
+			for (int i = this->blocks.begin(b); i < end; ++i) {
+//				if (this->geometry.lineXsurface(mols.r0[i],mols.r[i])) {
+//					mols.r[i] += jump_by;
+//					mols.r0[i] += jump_by;
+//					//mols.saved_index[i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
+//				}
+				if (this->geometry.distance_to_boundary(mols.r[i]) < 0) {
+					while (this->geometry.distance_to_boundary(mols.r[i]) < 0) {
+						mols.r[i] += jump_by;
+						mols.r0[i] += jump_by;
+						//mols.saved_index[i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
+					}
+					moved.push_back(i);
+				}
 			}
 		}
+		BOOST_FOREACH(int i, this->blocks.merge()) {
+			mols.update_cell_index(i);
+		}
 	}
 
 }
@@ -110,6 +121,7 @@ void JumpBoundaryWithCorrection<T>::integrate(const double dt) {
 				while (this->geometry.at_boundary(s.mols.r[p_i])) {
 					s.mols.r[p_i] += jump_by;
 				}
+				s.mols.update_cell_index(p_i);
 				//s.mols.saved_index[p_i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
 			}
 		}
@@ -172,13 +184,21 @@ void RemoveBoundary<T>::integrate(const double dt) {
 	for (int s_i = 0; s_i < s_n; ++s_i) {
 		Species &s = *(this->get_species()[s_i]);
 		Molecules& mols = s.mols;
-		const int p_n = s.mols.size();
-		for (int p_i = 0; p_i < p_n; ++p_i) {
-			if (this->geometry.lineXsurface(mols.r0[p_i],mols.r[p_i])) {
-				s.mols.mark_for_deletion(p_i);
-				removed_molecules[s_i].add_molecule(s.mols.r[p_i],mols.r0[p_i]);
+		const int nb = this->blocks.split(mols.size());
+		#pragma omp parallel for schedule(static) num_threads(this->blocks.get_number_of_threads()) if(this->blocks.is_parallel())
+		for (int b = 0; b < nb; ++b) {
+			std::vector<int>& crossed = this->blocks.get_list(b);
+			const int end = this->blocks.end(b);
+			for (int p_i = this->blocks.begin(b); p_i < end; ++p_i) {
+				if (this->geometry.lineXsurface(mols.r0[p_i],mols.r[p_i])) {
+					crossed.push_back(p_i);
+				}
 			}
 		}
+		BOOST_FOREACH(int p_i, this->blocks.merge()) {
+			s.mols.mark_for_deletion(p_i);
+			removed_molecules[s_i].add_molecule(s.mols.r[p_i],mols.r0[p_i]);
+		}
 		s.mols.delete_molecules();
 	}
 
@@ -189,22 +209,30 @@ void ReflectiveBoundary<T>::integrate(const double dt) {
 
 	BOOST_FOREACH(Species *s, this->get_species()) {
 		Molecules& mols = s->mols;
-		const int n = mols.size();
-		for (int i = 0; i < n; ++i) {
-//			Vect3d nv,ip;
-//			if (this->geometry.lineXsurface(mols.r0[i],mols.r[i],&ip,&nv)) {
-//				mols.r[i] += 2.0*(ip-mols.r[i]).dot(nv)*nv;
-//				//mols.saved_index[i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
-//			}
-			Vect3d nv;
-			const double d = this->geometry.distance_to_boundary(mols.r[i]);
-			if (d<0) {
-				const Vect3d vect_to_wall = this->geometry.shortest_vector_to_boundary(mols.r[i]);
-				mols.r0[i] = mols.r[i] + vect_to_wall;
-				mols.r[i] += 2.0*vect_to_wall;
-				//mols.saved_index[i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
+		const int nb = this->blocks.split(mols.size());
+		#pragma omp parallel for schedule(static) num_threads(this->blocks.get_number_of_threads()) if(this->blocks.is_parallel())
+		for (int b = 0; b < nb; ++b) {
+			std::vector<int>& moved = this->blocks.get_list(b);
+			const int end = this->blocks.end(b);
+			for (int i = this->blocks.begin(b); i < end; ++i) {
+//				Vect3d nv,ip;
+//				if (this->geometry.lineXsurface(mols.r0[i],mols.r[i],&ip,&nv)) {
+//					mols.r[i] += 2.0*(ip-mols.r[i]).dot(nv)*nv;
+//					//mols.saved_index[i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
+//				}
+				const double d = this->geometry.distance_to_boundary(mols.r[i]);
+				if (d<0) {
+					const Vect3d vect_to_wall = this->geometry.shortest_vector_to_boundary(mols.r[i]);
+					mols.r0[i] = mols.r[i] + vect_to_wall;
+					mols.r[i] += 2.0*vect_to_wall;
+					moved.push_back(i);
+					//mols.saved_index[i] = SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE;
+				}
 			}
 		}
+		BOOST_FOREACH(int i, this->blocks.merge()) {
+			mols.update_cell_index(i);
+		}
 	}
 
 }
@@ -232,7 +260,6 @@ void CouplingBoundary_M_to_C<T>::integrate(const double dt) {
 
 	DiffusionCorrectedBoundary<T>::timestep_initialise(dt);
 	const int s_n = this->get_species().size();
-	std::set<int> dirty_indicies;
 	for (int s_i = 0; s_i < s_n; ++s_i) {
 		Species &s = *(this->get_species()[s_i]);
 		const int p_n = s.mols.size();
@@ -250,8 +277,7 @@ void CouplingBoundary_M_to_C<T>::integrate(const double dt) {
 //					comp_r += (1.0 - s.grid.get_tolerance())*this->geometry.shortest_vector_to_boundary(r);
 //				}
 				const int i = s.grid->get_cell_index(comp_r);
-				dirty_indicies.insert(i);
-				//dirty_indicies.push_back(i);
+				nsm.mark_cell_dirty(i);
 				s.copy_numbers[i]++;
 				s.mols.mark_for_deletion(p_i);
 			}
@@ -260,9 +286,6 @@ void CouplingBoundary_M_to_C<T>::integrate(const double dt) {
 		s.mols.delete_molecules();
 		//std::cout << count << "particles moved to compartments. Free space = "<<s.mols.size() <<" compart = "<< std::accumulate(s.copy_numbers.begin(),s.copy_numbers.end(),0) << std::endl;
 	}
-	BOOST_FOREACH(int i, dirty_indicies) {
-		nsm.recalc_priority(i);
-	}
 	DiffusionCorrectedBoundary<T>::timestep_finalise();
 
 }
@@ -272,7 +295,6 @@ void CouplingBoundary<T>::integrate(const double dt) {
 	boost::variate_generator<base_generator_type&, boost::uniform_real<> > uni(generator,boost::uniform_real<>(0,1));
 
 	const int s_n = this->get_species().size();
-	std::set<int> dirty_indicies;
 	for (int s_i = 0; s_i < s_n; ++s_i) {
 		Species &s = *(this->get_species()[s_i]);
 		const int p_n = s.mols.size();
@@ -282,7 +304,7 @@ void CouplingBoundary<T>::integrate(const double dt) {
 			if (this->geometry.is_in(r)) {
 				const int i = s.grid->get_cell_index(r);
 				ASSERT(i>=0, "Invalid negative compartment index!");
-				dirty_indicies.insert(i);
+				nsm->mark_cell_dirty(i);
 				s.copy_numbers[i]++;
 				s.mols.mark_for_deletion(p_i);
 			} else if (corrected) {
@@ -296,7 +318,7 @@ void CouplingBoundary<T>::integrate(const double dt) {
 				if (uni() < P) {
 					const int i = s.grid->get_cell_index(r + 1.000001*vect_to_wall);
 					ASSERT(i>=0, "Invalid negative compartment index!");
-					dirty_indicies.insert(i);
+					nsm->mark_cell_dirty(i);
 					s.copy_numbers[i]++;
 					s.mols.mark_for_deletion(p_i);
 				}
@@ -305,9 +327,6 @@ void CouplingBoundary<T>::integrate(const double dt) {
 		s.mols.delete_molecules();
 		//std::cout << count << "particles moved to compartments. Free space = "<<s.mols.size() <<" compart = "<< std::accumulate(s.copy_numbers.begin(),s.copy_numbers.end(),0) << std::endl;
 	}
-	BOOST_FOREACH(int i, dirty_indicies) {
-		nsm->recalc_priority(i);
-	}
 }
 
 
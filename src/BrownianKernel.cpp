@@ -0,0 +1,215 @@
+/*
+ * BrownianKernel.cpp
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "BrownianKernel.h"
+#include "MyRandom.h"
+#include "Log.h"
+#include <cstring>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BROWNIAN_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace Tyche {
+
+namespace scalar {
+#define BROWNIAN_TARGET
+typedef double VD;
+typedef uint64_t VI;
+const int W = 1;
+inline VD set1(const double a) { return a; }
+inline VD add(const VD a, const VD b) { return a + b; }
+inline VD sub(const VD a, const VD b) { return a - b; }
+inline VD mul(const VD a, const VD b) { return a * b; }
+inline VD div(const VD a, const VD b) { return a / b; }
+inline VD sqrt(const VD a) { return std::sqrt(a); }
+inline VI set1_i(const uint64_t a) { return a; }
+inline VI add_i(const VI a, const VI b) { return a + b; }
+inline VI sub_i(const VI a, const VI b) { return a - b; }
+inline VI and_i(const VI a, const VI b) { return a & b; }
+inline VI andnot_i(const VI a, const VI b) { return ~a & b; }
+inline VI or_i(const VI a, const VI b) { return a | b; }
+inline VI xor_i(const VI a, const VI b) { return a ^ b; }
+template<int K> inline VI slli(const VI a) { return a << K; }
+template<int K> inline VI srli(const VI a) { return a >> K; }
+inline VD as_double(const VI a) { VD d; memcpy(&d,&a,sizeof(d)); return d; }
+inline VI as_int(const VD a) { VI i; memcpy(&i,&a,sizeof(i)); return i; }
+inline VI load_i(const uint64_t* p) { return *p; }
+inline void store_i(uint64_t* p, const VI a) { *p = a; }
+inline void store_d(double* p, const VD a) { *p = a; }
+#include "BrownianKernel.impl.h"
+#undef BROWNIAN_TARGET
+}
+
+#ifdef BROWNIAN_KERNEL_X86
+namespace avx2 {
+#define BROWNIAN_TARGET __attribute__((target("avx2")))
+typedef __m256d VD;
+typedef __m256i VI;
+const int W = 4;
+BROWNIAN_TARGET inline VD set1(const double a) { return _mm256_set1_pd(a); }
+BROWNIAN_TARGET inline VD add(const VD a, const VD b) { return _mm256_add_pd(a,b); }
+BROWNIAN_TARGET inline VD sub(const VD a, const VD b) { return _mm256_sub_pd(a,b); }
+BROWNIAN_TARGET inline VD mul(const VD a, const VD b) { return _mm256_mul_pd(a,b); }
+BROWNIAN_TARGET inline VD div(const VD a, const VD b) { return _mm256_div_pd(a,b); }
+BROWNIAN_TARGET inline VD sqrt(const VD a) { return _mm256_sqrt_pd(a); }
+BROWNIAN_TARGET inline VI set1_i(const uint64_t a) { return _mm256_set1_epi64x(a); }
+BROWNIAN_TARGET inline VI add_i(const VI a, const VI b) { return _mm256_add_epi64(a,b); }
+BROWNIAN_TARGET inline VI sub_i(const VI a, const VI b) { return _mm256_sub_epi64(a,b); }
+BROWNIAN_TARGET inline VI and_i(const VI a, const VI b) { return _mm256_and_si256(a,b); }
+BROWNIAN_TARGET inline VI andnot_i(const VI a, const VI b) { return _mm256_andnot_si256(a,b); }
+BROWNIAN_TARGET inline VI or_i(const VI a, const VI b) { return _mm256_or_si256(a,b); }
+BROWNIAN_TARGET inline VI xor_i(const VI a, const VI b) { return _mm256_xor_si256(a,b); }
+template<int K> BROWNIAN_TARGET inline VI slli(const VI a) { return _mm256_slli_epi64(a,K); }
+template<int K> BROWNIAN_TARGET inline VI srli(const VI a) { return _mm256_srli_epi64(a,K); }
+BROWNIAN_TARGET inline VD as_double(const VI a) { return _mm256_castsi256_pd(a); }
+BROWNIAN_TARGET inline VI as_int(const VD a) { return _mm256_castpd_si256(a); }
+BROWNIAN_TARGET inline VI load_i(const uint64_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+BROWNIAN_TARGET inline void store_i(uint64_t* p, const VI a) { _mm256_storeu_si256((__m256i*)p,a); }
+BROWNIAN_TARGET inline void store_d(double* p, const VD a) { _mm256_storeu_pd(p,a); }
+#include "BrownianKernel.impl.h"
+#undef BROWNIAN_TARGET
+}
+
+namespace avx512 {
+#define BROWNIAN_TARGET __attribute__((target("avx512f")))
+typedef __m512d VD;
+typedef __m512i VI;
+const int W = 8;
+BROWNIAN_TARGET inline VD set1(const double a) { return _mm512_set1_pd(a); }
+BROWNIAN_TARGET inline VD add(const VD a, const VD b) { return _mm512_add_pd(a,b); }
+BROWNIAN_TARGET inline VD sub(const VD a, const VD b) { return _mm512_sub_pd(a,b); }
+BROWNIAN_TARGET inline VD mul(const VD a, const VD b) { return _mm512_mul_pd(a,b); }
+BROWNIAN_TARGET inline VD div(const VD a, const VD b) { return _mm512_div_pd(a,b); }
+BROWNIAN_TARGET inline VD sqrt(const VD a) { return _mm512_sqrt_pd(a); }
+BROWNIAN_TARGET inline VI set1_i(const uint64_t a) { return _mm512_set1_epi64(a); }
+BROWNIAN_TARGET inline VI add_i(const VI a, const VI b) { return _mm512_add_epi64(a,b); }
+BROWNIAN_TARGET inline VI sub_i(const VI a, const VI b) { return _mm512_sub_epi64(a,b); }
+BROWNIAN_TARGET inline VI and_i(const VI a, const VI b) { return _mm512_and_si512(a,b); }
+BROWNIAN_TARGET inline VI andnot_i(const VI a, const VI b) { return _mm512_andnot_si512(a,b); }
+BROWNIAN_TARGET inline VI or_i(const VI a, const VI b) { return _mm512_or_si512(a,b); }
+BROWNIAN_TARGET inline VI xor_i(const VI a, const VI b) { return _mm512_xor_si512(a,b); }
+template<int K> BROWNIAN_TARGET inline VI slli(const VI a) { return _mm512_slli_epi64(a,K); }
+template<int K> BROWNIAN_TARGET inline VI srli(const VI a) { return _mm512_srli_epi64(a,K); }
+BROWNIAN_TARGET inline VD as_double(const VI a) { return _mm512_castsi512_pd(a); }
+BROWNIAN_TARGET inline VI as_int(const VD a) { return _mm512_castpd_si512(a); }
+BROWNIAN_TARGET inline VI load_i(const uint64_t* p) { return _mm512_loadu_si512(p); }
+BROWNIAN_TARGET inline void store_i(uint64_t* p, const VI a) { _mm512_storeu_si512(p,a); }
+BROWNIAN_TARGET inline void store_d(double* p, const VD a) { _mm512_storeu_pd(p,a); }
+#include "BrownianKernel.impl.h"
+#undef BROWNIAN_TARGET
+}
+#endif
+
+BrownianKernel::BrownianKernel():
+		instruction_set(get_best_instruction_set()),
+		seeded(false),
+		keyed(false),
+		seed_generation(0),
+		normals(BLOCK),
+		scale(BLOCK) {
+	memset(state,0,sizeof(state));
+}
+
+bool BrownianKernel::is_supported(const InstructionSet set) {
+	switch (set) {
+	case SCALAR:
+		return true;
+#ifdef BROWNIAN_KERNEL_X86
+	case AVX2:
+		return __builtin_cpu_supports("avx2");
+	case AVX512:
+		return __builtin_cpu_supports("avx512f");
+#endif
+	default:
+		return false;
+	}
+}
+
+BrownianKernel::InstructionSet BrownianKernel::get_best_instruction_set() {
+	if (is_supported(AVX512)) return AVX512;
+	if (is_supported(AVX2)) return AVX2;
+	return SCALAR;
+}
+
+const char* BrownianKernel::get_name(const InstructionSet set) {
+	switch (set) {
+	case AVX2:
+		return "avx2";
+	case AVX512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+void BrownianKernel::set_instruction_set(const InstructionSet set) {
+	CHECK(is_supported(set),"this CPU does not support the "<<get_name(set)<<" Brownian kernel");
+	instruction_set = set;
+}
+
+void BrownianKernel::seed() {
+	for (int i = 0; i < 4*LANES; ++i) {
+		state[i] = (uint64_t(generator()) << 32) | uint64_t(generator());
+	}
+	for (int l = 0; l < LANES; ++l) {
+		if ((state[l] | state[LANES+l] | state[2*LANES+l] | state[3*LANES+l]) == 0) state[l] = 1;
+	}
+	seeded = true;
+	keyed = false;
+	seed_generation = generator_seeds;
+}
+
+void BrownianKernel::seed(const uint64_t key) {
+	uint64_t x = key;
+	for (int i = 0; i < 4*LANES; ++i) {
+		x += 0x9E3779B97F4A7C15ULL;
+		uint64_t z = x;
+		z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+		state[i] = z ^ (z >> 31);
+	}
+	seeded = true;
+	keyed = true;
+}
+
+void BrownianKernel::generate(const int n) {
+	const int rounded = (n + 2*LANES - 1)/(2*LANES)*(2*LANES);
+	switch (instruction_set) {
+#ifdef BROWNIAN_KERNEL_X86
+	case AVX512:
+		avx512::fill_normals(state,&normals[0],rounded);
+		break;
+	case AVX2:
+		avx2::fill_normals(state,&normals[0],rounded);
+		break;
+#endif
+	default:
+		scalar::fill_normals(state,&normals[0],rounded);
+	}
+}
+
+void BrownianKernel::step(double* r, double* r0, const int n, const Vect3d& step_length) {
+	if (!seeded || (!keyed && (seed_generation != generator_seeds))) seed();
+	for (int k = 0; k < BLOCK; ++k) {
+		scale[k] = step_length[k%3];
+	}
+	const int length = 3*n;
+	for (int begin = 0; begin < length; begin += BLOCK) {
+		const int m = std::min(BLOCK,length - begin);
+		generate(m);
+		double* rb = r + begin;
+		double* r0b = r0 + begin;
+		for (int k = 0; k < m; ++k) {
+			r0b[k] = rb[k];
+			rb[k] += scale[k]*normals[k];
+		}
+	}
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+ * BrownianKernel.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef BROWNIANKERNEL_H_
+#define BROWNIANKERNEL_H_
+
+#include "Vector.h"
+#include <vector>
+#include <stdint.h>
+
+namespace Tyche {
+
+/*
+ * Brownian steps r0 = r, r += step_length*N(0,1) for many molecules at
+ * once. The normals come from a vectorised generator: xoshiro256+ in 8
+ * lanes, turned into pairs of normals by Box-Muller with polynomial log,
+ * sin and cos. The kernel is compiled for AVX-512, AVX2 and plain scalar
+ * code, and the best one the CPU supports is used. All of them give the
+ * same lanes and so the same normals (BrownianKernel.cpp is compiled
+ * without contracting multiplies and adds into FMAs).
+ *
+ * The lanes are seeded from the global generator on the first step, and
+ * again on the first step after it is reseeded (see random_seed) or after
+ * unseed().
+ */
+class BrownianKernel {
+public:
+	enum InstructionSet {SCALAR, AVX2, AVX512};
+
+	BrownianKernel();
+	static InstructionSet get_best_instruction_set();
+	static bool is_supported(const InstructionSet set);
+	static const char* get_name(const InstructionSet set);
+	void set_instruction_set(const InstructionSet set);
+	InstructionSet get_instruction_set() const { return instruction_set; }
+	void seed();
+	/*
+	 * seed the lanes from key alone (with splitmix64), for streams that
+	 * must not depend on the order they are used in
+	 */
+	void seed(const uint64_t key);
+	/*
+	 * seed the lanes from the global generator again on the next step
+	 */
+	void unseed() { seeded = false; }
+
+	/*
+	 * positions r and r0 hold n molecules as x,y,z triples (e.g. the
+	 * Molecules::r array of Vect3d)
+	 */
+	void step(double* r, double* r0, const int n, const Vect3d& step_length);
+
+	static const int LANES = 8;
+
+private:
+	/*
+	 * normals generated per block, a multiple of 2*LANES and of 3
+	 */
+	static const int BLOCK = 768;
+	void generate(const int n);
+
+	InstructionSet instruction_set;
+	bool seeded;
+	/*
+	 * lanes seeded from a key are left alone when the generator is
+	 * reseeded, the others remember which seeding they come from
+	 */
+	bool keyed;
+	unsigned long seed_generation;
+	uint64_t state[4*LANES];
+	std::vector<double> normals;
+	std::vector<double> scale;
+};
+
+}
+
+#endif /* BROWNIANKERNEL_H_ */
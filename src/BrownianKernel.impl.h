@@ -0,0 +1,131 @@
+/*
+ * BrownianKernel.impl.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+/*
+ * normal generator of BrownianKernel, included by BrownianKernel.cpp once
+ * per instruction set (so no include guard), after defining BROWNIAN_TARGET,
+ * the number of lanes W in a pack, and the operations on packs of doubles
+ * (VD) and 64 bit integers (VI)
+ */
+
+/*
+ * one step of xoshiro256+ in each lane
+ */
+BROWNIAN_TARGET inline VI next(VI* s) {
+	const VI result = add_i(s[0],s[3]);
+	const VI t = slli<17>(s[1]);
+	s[2] = xor_i(s[2],s[0]);
+	s[3] = xor_i(s[3],s[1]);
+	s[1] = xor_i(s[1],s[2]);
+	s[0] = xor_i(s[0],s[3]);
+	s[2] = xor_i(s[2],t);
+	s[3] = or_i(slli<45>(s[3]),srli<19>(s[3]));
+	return result;
+}
+
+/*
+ * the top 52 bits of x as a double in [1,2)
+ */
+BROWNIAN_TARGET inline VD one_to_two(const VI x) {
+	return as_double(or_i(srli<12>(x),set1_i(0x3FF0000000000000ULL)));
+}
+
+/*
+ * natural log of u > 0: u = 2^k m with m in [sqrt(2)/2,sqrt(2)), and
+ * log(m) = 2 atanh(s) with s = (m-1)/(m+1), |s| < 0.172
+ */
+BROWNIAN_TARGET inline VD log_positive(const VD u) {
+	VI bits = as_int(u);
+	VI hx = add_i(srli<32>(bits),set1_i(0x3ff00000ULL - 0x3fe6a09eULL));
+	const VI k = srli<20>(hx);
+	hx = add_i(and_i(hx,set1_i(0x000fffffULL)),set1_i(0x3fe6a09eULL));
+	bits = or_i(slli<32>(hx),and_i(bits,set1_i(0xffffffffULL)));
+	const VD m = as_double(bits);
+	const VD exponent = sub(as_double(or_i(k,set1_i(0x4330000000000000ULL))),set1(4503599627370496.0 + 1023.0));
+
+	const VD f = sub(m,set1(1.0));
+	const VD s = div(f,add(f,set1(2.0)));
+	const VD z = mul(s,s);
+	VD p = set1(2.0/19);
+	p = add(mul(p,z),set1(2.0/17));
+	p = add(mul(p,z),set1(2.0/15));
+	p = add(mul(p,z),set1(2.0/13));
+	p = add(mul(p,z),set1(2.0/11));
+	p = add(mul(p,z),set1(2.0/9));
+	p = add(mul(p,z),set1(2.0/7));
+	p = add(mul(p,z),set1(2.0/5));
+	p = add(mul(p,z),set1(2.0/3));
+	p = add(mul(p,z),set1(2.0));
+	return add(mul(exponent,set1(0.69314718055994530942)),mul(s,p));
+}
+
+/*
+ * 2*LANES normals from the lanes in s: out[0..W) from the cosine and
+ * out[LANES..LANES+W) from the sine
+ */
+BROWNIAN_TARGET inline void normal_pair(VI* s, double* out) {
+	const VD u = sub(set1(2.0),one_to_two(next(s)));
+	const VD radius = sqrt(mul(set1(-2.0),log_positive(u)));
+
+	/*
+	 * the angle is x in [-pi/4,pi/4) plus a random quadrant q
+	 */
+	const VI y = next(s);
+	const VD x = mul(sub(one_to_two(y),set1(1.5)),set1(1.57079632679489661923));
+	const VI q = and_i(srli<10>(y),set1_i(3));
+	const VD x2 = mul(x,x);
+	VD sine = set1(-1.0/1307674368000.0);
+	sine = add(mul(sine,x2),set1(1.0/6227020800.0));
+	sine = add(mul(sine,x2),set1(-1.0/39916800.0));
+	sine = add(mul(sine,x2),set1(1.0/362880.0));
+	sine = add(mul(sine,x2),set1(-1.0/5040.0));
+	sine = add(mul(sine,x2),set1(1.0/120.0));
+	sine = add(mul(sine,x2),set1(-1.0/6.0));
+	sine = add(mul(mul(sine,x2),x),x);
+	VD cosine = set1(1.0/20922789888000.0);
+	cosine = add(mul(cosine,x2),set1(-1.0/87178291200.0));
+	cosine = add(mul(cosine,x2),set1(1.0/479001600.0));
+	cosine = add(mul(cosine,x2),set1(-1.0/3628800.0));
+	cosine = add(mul(cosine,x2),set1(1.0/40320.0));
+	cosine = add(mul(cosine,x2),set1(-1.0/720.0));
+	cosine = add(mul(cosine,x2),set1(1.0/24.0));
+	cosine = add(mul(cosine,x2),set1(-0.5));
+	cosine = add(mul(cosine,x2),set1(1.0));
+
+	/*
+	 * rotate (cos,sin) by q quarter turns: swap for odd q, then flip the
+	 * signs of the first for q = 1,2 and of the second for q = 2,3
+	 */
+	const VI swap = sub_i(set1_i(0),and_i(q,set1_i(1)));
+	const VI c = as_int(cosine);
+	const VI sn = as_int(sine);
+	VI first = or_i(and_i(swap,sn),andnot_i(swap,c));
+	VI second = or_i(and_i(swap,c),andnot_i(swap,sn));
+	first = xor_i(first,slli<63>(and_i(xor_i(q,srli<1>(q)),set1_i(1))));
+	second = xor_i(second,slli<63>(srli<1>(q)));
+	store_d(out,mul(radius,as_double(first)));
+	store_d(out + BrownianKernel::LANES,mul(radius,as_double(second)));
+}
+
+/*
+ * n normals, n a multiple of 2*LANES, from the lanes in state (4 words of
+ * LANES lanes)
+ */
+BROWNIAN_TARGET void fill_normals(uint64_t* state, double* out, const int n) {
+	const int lanes = BrownianKernel::LANES;
+	for (int l = 0; l < lanes; l += W) {
+		VI s[4];
+		for (int k = 0; k < 4; ++k) {
+			s[k] = load_i(state + k*lanes + l);
+		}
+		for (int i = 0; i < n; i += 2*lanes) {
+			normal_pair(s,out + i + l);
+		}
+		for (int k = 0; k < 4; ++k) {
+			store_i(state + k*lanes + l,s[k]);
+		}
+	}
+}
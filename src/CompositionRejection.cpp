@@ -0,0 +1,181 @@
+/*
+ * CompositionRejection.cpp
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "CompositionRejection.h"
+#include "Log.h"
+#include <cmath>
+
+namespace Tyche {
+
+CompositionRejection::CompositionRejection(Grid& subvolumes):
+		NextSubvolumeMethod(subvolumes),
+		groups(max_exponent-min_exponent+1),
+		number_of_rejections(0) {
+	const int n = subvolumes.size();
+	cell_group.assign(n,-1);
+	cell_position.assign(n,-1);
+	cell_propensity.assign(n,0);
+}
+
+void CompositionRejection::reset_all_priorities() {
+	const int n = subvolumes.size();
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; ++i) {
+		reset_propensities(i);
+	}
+	BOOST_FOREACH(int g, active_groups) {
+		groups[g] = Group();
+	}
+	active_groups.clear();
+	cell_group.assign(n,-1);
+	cell_position.assign(n,-1);
+	cell_propensity.assign(n,0);
+	for (int i = 0; i < n; ++i) {
+		update_group(i);
+	}
+}
+
+void CompositionRejection::schedule(const int i, const bool) {
+	update_group(i);
+}
+
+void CompositionRejection::reschedule(const int i, const double) {
+	update_group(i);
+}
+
+void CompositionRejection::update_group(const int i) {
+	const double propensity = subvolume_reactions[i].get_propensity();
+	int g = -1;
+	if (propensity > 0) {
+		int exponent;
+		frexp(propensity,&exponent);
+		g = exponent - min_exponent;
+	}
+	if (g == cell_group[i]) {
+		if (g >= 0) groups[g].sum += propensity - cell_propensity[i];
+		cell_propensity[i] = propensity;
+		return;
+	}
+
+	if (cell_group[i] >= 0) remove_from_group(i);
+	if (g >= 0) {
+		Group& group = groups[g];
+		if (group.members.empty()) {
+			group.active_index = active_groups.size();
+			active_groups.push_back(g);
+		}
+		cell_group[i] = g;
+		cell_position[i] = group.members.size();
+		group.members.push_back(i);
+		group.sum += propensity;
+	}
+	cell_propensity[i] = propensity;
+}
+
+void CompositionRejection::remove_from_group(const int i) {
+	const int g = cell_group[i];
+	Group& group = groups[g];
+
+	/*
+	 * the last member takes the place of the removed one
+	 */
+	const int last = group.members.back();
+	group.members[cell_position[i]] = last;
+	cell_position[last] = cell_position[i];
+	group.members.pop_back();
+	cell_group[i] = -1;
+	cell_position[i] = -1;
+
+	if (group.members.empty()) {
+		group.sum = 0;
+		const int moved = active_groups.back();
+		active_groups[group.active_index] = moved;
+		groups[moved].active_index = group.active_index;
+		active_groups.pop_back();
+		group.active_index = -1;
+	} else {
+		group.sum -= cell_propensity[i];
+
+		/*
+		 * resum when round-off could leave the sum too small for its members
+		 */
+		if (group.sum <= 1e-9*cell_propensity[i]) {
+			group.sum = 0;
+			BOOST_FOREACH(int j, group.members) {
+				group.sum += cell_propensity[j];
+			}
+		}
+	}
+}
+
+double CompositionRejection::get_total_propensity() const {
+	double total = 0;
+	BOOST_FOREACH(int g, active_groups) {
+		total += groups[g].sum;
+	}
+	return total;
+}
+
+int CompositionRejection::pick_subvolume() {
+	/*
+	 * composition: a group in proportion to its summed propensity
+	 */
+	const double rand_times_total = uni()*get_total_propensity();
+	const int na = active_groups.size();
+	int g = active_groups[na-1];
+	double sum = 0;
+	for (int k = 0; k < na; ++k) {
+		sum += groups[active_groups[k]].sum;
+		if (rand_times_total < sum) {
+			g = active_groups[k];
+			break;
+		}
+	}
+
+	/*
+	 * rejection: a member uniformly, accepted with probability
+	 * propensity/(upper bound of the group)
+	 */
+	const Group& group = groups[g];
+	const double max_propensity = ldexp(1.0,g+min_exponent);
+	const int nm = group.members.size();
+	while (true) {
+		int k = int(uni()*nm);
+		if (k >= nm) k = nm-1;
+		const int i = group.members[k];
+		if (uni()*max_propensity < cell_propensity[i]) return i;
+		number_of_rejections++;
+	}
+}
+
+void CompositionRejection::integrate(const double dt) {
+	if (!dependency_graph_valid) build_dependency_graph();
+	time = get_time();
+	refresh_rate_parameters();
+	flush_dirty_cells();
+	const double final_time = time + dt;
+	while (!active_groups.empty()) {
+		const double total_propensity = get_total_propensity();
+		double rand = uni();
+		while (rand==0.0) rand = uni();
+		const double next_time = time - log(rand)/total_propensity;
+		if (next_time > final_time) break;
+		time = next_time;
+		number_of_events++;
+
+		const int sv_i = pick_subvolume();
+		const int k = subvolume_reactions[sv_i].pick_random_reaction(uni());
+		react(sv_i,k);
+	}
+	time = final_time;
+}
+
+void CompositionRejection::print(std::ostream& out) const {
+	out << "\tComposition-Rejection SSA ("<<active_groups.size()<<" propensity groups):"<<std::endl;
+	NextSubvolumeMethod::print(out);
+}
+
+}
@@ -0,0 +1,77 @@
+/*
+ * CompositionRejection.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef COMPOSITIONREJECTION_H_
+#define COMPOSITIONREJECTION_H_
+
+#include "NextSubvolumeMethod.h"
+
+namespace Tyche {
+
+/*
+ * Exact spatial SSA with the same grid, reactions and diffusion as the
+ * NextSubvolumeMethod, but without an event queue. Subvolumes are binned by
+ * total propensity, bin g holding those with propensity in [2^(g-1),2^g).
+ * Each event picks a bin in proportion to its summed propensity
+ * (composition), then a subvolume in the bin uniformly, accepting it with
+ * probability propensity/2^g (rejection, at least 1/2). Selection and update
+ * cost depend on the number of bins in use, not on the number of
+ * subvolumes (Slepoy, Thompson and Plimpton 2008).
+ *
+ * The event queue settings of the NextSubvolumeMethod (indexed heap, time
+ * rescaling) have no effect.
+ */
+class CompositionRejection: public NextSubvolumeMethod {
+public:
+	CompositionRejection(Grid& subvolumes);
+	static std::auto_ptr<CompositionRejection> New(const Vect3d& min, const Vect3d& max, const Vect3d& h) {
+		Grid* grid = new StructuredGrid(min,max,h);
+		return std::auto_ptr<CompositionRejection>(new CompositionRejection(*grid));
+	}
+	static std::auto_ptr<CompositionRejection> New(Grid& grid) {
+		return std::auto_ptr<CompositionRejection>(new CompositionRejection(grid));
+	}
+
+	virtual void reset_all_priorities();
+	int get_number_of_groups() const { return active_groups.size(); }
+	unsigned long get_number_of_rejections() const { return number_of_rejections; }
+
+protected:
+	virtual void integrate(const double dt);
+	virtual void print(std::ostream& out) const;
+	virtual void schedule(const int i, const bool in_queue);
+	virtual void reschedule(const int i, const double old_propensity);
+
+private:
+	struct Group {
+		Group():sum(0),active_index(-1) {}
+		std::vector<int> members;
+		double sum;
+		int active_index;
+	};
+
+	void update_group(const int i);
+	void remove_from_group(const int i);
+	double get_total_propensity() const;
+	int pick_subvolume();
+
+	/*
+	 * groups[e-min_exponent] holds the subvolumes with propensity in
+	 * [2^(e-1),2^e), active_groups the indices of the non-empty ones
+	 */
+	static const int min_exponent = -1100;
+	static const int max_exponent = 1100;
+	std::vector<Group> groups;
+	std::vector<int> active_groups;
+	std::vector<int> cell_group;
+	std::vector<int> cell_position;
+	std::vector<double> cell_propensity;
+	unsigned long number_of_rejections;
+};
+
+}
+
+#endif /* COMPOSITIONREJECTION_H_ */
@@ -49,11 +49,11 @@ template<typename T>
 class GrowingInterface: public Control<T> {
 public:
 	struct my_accumulate {
-		my_accumulate(std::vector<int>& vect_to_sum):vect_to_sum(vect_to_sum) {}
+		my_accumulate(CopyNumbers& vect_to_sum):vect_to_sum(vect_to_sum) {}
 		int operator()(int x, int y) {
 			return x+vect_to_sum[y];
 		}
-		std::vector<int>& vect_to_sum;
+		CopyNumbers& vect_to_sum;
 	};
 
 	GrowingInterface(T& geometry, NextSubvolumeMethod& nsm,
@@ -33,6 +33,7 @@ void GrowingInterface<T>::integrate(const double dt) {
 	//Operator::operator()();
 	if (last_check > check_dt) {
 		last_check = 0;
+		nsm.synchronise();
 		ASSERT(this->get_species().size() > 0,"no species!!");
 		//TODO: assumes only one species;
 		Species &s = *(this->get_species()[0]);
@@ -69,6 +70,7 @@ void GrowingInterface<T>::integrate(const double dt) {
 							ASSERT(s.copy_numbers[i]>=0,"can't have negative copy numbers");
 						}
 					}
+					nsm.mark_cell_dirty(i);
 				}
 				this->geometry -= move_by;
 				s.grid->get_slice(this->geometry,grid_indices_shrink2);
@@ -111,7 +113,9 @@ void GrowingInterface<T>::integrate(const double dt) {
 				 * delete particles behind interface and add them to compartments
 				 */
 				BOOST_FOREACH(int i, mol_indices) {
-					s.copy_numbers[s.grid->get_cell_index(s.mols.r[i])]++;
+					const int cell = s.grid->get_cell_index(s.mols.r[i]);
+					s.copy_numbers[cell]++;
+					nsm.mark_cell_dirty(cell);
 					s.mols.delete_molecule(i);
 				}
 				nsm.unset_interface_reactions(grid_indices_shrink, grid_indices_current);
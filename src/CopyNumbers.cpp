@@ -0,0 +1,190 @@
+/*
+ * CopyNumbers.cpp
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "CopyNumbers.h"
+#include <algorithm>
+#include <iostream>
+
+namespace Tyche {
+
+CopyNumberStore::CopyNumberStore(const int number_of_cells):
+		number_of_cells(number_of_cells),
+		stride(0),
+		narrow(false),
+		paged(false) {}
+
+int CopyNumberStore::add_slot() {
+	if (!free_slots.empty()) {
+		const int slot = free_slots.back();
+		free_slots.pop_back();
+		for (int i = 0; i < number_of_cells; ++i) {
+			set(i,slot,0);
+		}
+		return slot;
+	}
+	relayout(stride+1);
+	return stride-1;
+}
+
+void CopyNumberStore::release_slot(const int slot) {
+	free_slots.push_back(slot);
+}
+
+bool CopyNumberStore::set_narrow(const bool use) {
+	if (use == narrow) return narrow;
+	if (paged) return false;
+	if (!use) {
+		promote();
+		return false;
+	}
+	const int n = data.size();
+	for (int k = 0; k < n; ++k) {
+		if ((data[k] < std::numeric_limits<int16_t>::min()) || (data[k] > std::numeric_limits<int16_t>::max())) {
+			return false;
+		}
+	}
+	narrow_data.assign(data.begin(),data.end());
+	std::vector<int>().swap(data);
+	narrow = true;
+	return true;
+}
+
+void CopyNumberStore::set_paged(const bool use) {
+	if (use == paged) return;
+	const int n = number_of_cells;
+	if (use) {
+		promote();
+		pages.assign((n + PAGE_SIZE-1) >> PAGE_SHIFT,std::vector<int>());
+		paged = true;
+		for (int i = 0; i < n; ++i) {
+			for (int s = 0; s < stride; ++s) {
+				set(i,s,data[i*stride+s]);
+			}
+		}
+		std::vector<int>().swap(data);
+	} else {
+		data.assign(n*stride,0);
+		for (int i = 0; i < n; ++i) {
+			for (int s = 0; s < stride; ++s) {
+				data[i*stride+s] = get(i,s);
+			}
+		}
+		std::vector<std::vector<int> >().swap(pages);
+		paged = false;
+	}
+}
+
+void CopyNumberStore::release_empty_pages() {
+	const int np = pages.size();
+	for (int p = 0; p < np; ++p) {
+		if (pages[p].empty()) continue;
+		if (std::count(pages[p].begin(),pages[p].end(),0) == int(pages[p].size())) {
+			std::vector<int>().swap(pages[p]);
+		}
+	}
+}
+
+void CopyNumberStore::relayout(const int new_stride) {
+	const int n = number_of_cells;
+	const int ns = std::min(stride,new_stride);
+	if (paged) {
+		const int np = pages.size();
+		for (int p = 0; p < np; ++p) {
+			if (pages[p].empty()) continue;
+			std::vector<int> new_page(PAGE_SIZE*new_stride,0);
+			for (int i = 0; i < PAGE_SIZE; ++i) {
+				for (int s = 0; s < ns; ++s) {
+					new_page[i*new_stride+s] = pages[p][i*stride+s];
+				}
+			}
+			pages[p].swap(new_page);
+		}
+	} else if (narrow) {
+		std::vector<int16_t> new_data(n*new_stride,0);
+		for (int i = 0; i < n; ++i) {
+			for (int s = 0; s < ns; ++s) {
+				new_data[i*new_stride+s] = narrow_data[i*stride+s];
+			}
+		}
+		narrow_data.swap(new_data);
+	} else {
+		std::vector<int> new_data(n*new_stride,0);
+		for (int i = 0; i < n; ++i) {
+			for (int s = 0; s < ns; ++s) {
+				new_data[i*new_stride+s] = data[i*stride+s];
+			}
+		}
+		data.swap(new_data);
+	}
+	stride = new_stride;
+}
+
+void CopyNumberStore::promote() {
+	if (!narrow) return;
+	LOG(2,"promoting the copy numbers of "<<stride<<" species in "<<number_of_cells<<" subvolumes to 32 bit");
+	data.assign(narrow_data.begin(),narrow_data.end());
+	std::vector<int16_t>().swap(narrow_data);
+	narrow = false;
+}
+
+
+CopyNumbers::CopyNumbers():
+		store(new CopyNumberStore(0)) {
+	slot = store->add_slot();
+}
+
+CopyNumbers::CopyNumbers(const CopyNumbers& arg):
+		store(new CopyNumberStore(arg.size())) {
+	slot = store->add_slot();
+	const int n = size();
+	for (int i = 0; i < n; ++i) {
+		store->set(i,slot,arg[i]);
+	}
+}
+
+CopyNumbers& CopyNumbers::operator=(const CopyNumbers& arg) {
+	if (&arg == this) return *this;
+	const int n = arg.size();
+	if (n != size()) {
+		store->release_slot(slot);
+		store.reset(new CopyNumberStore(n));
+		slot = store->add_slot();
+	}
+	for (int i = 0; i < n; ++i) {
+		store->set(i,slot,arg[i]);
+	}
+	return *this;
+}
+
+CopyNumbers::~CopyNumbers() {
+	store->release_slot(slot);
+}
+
+void CopyNumbers::assign(const int n, const int value) {
+	if (n != size()) {
+		store->release_slot(slot);
+		store.reset(new CopyNumberStore(n));
+		slot = store->add_slot();
+	}
+	for (int i = 0; i < n; ++i) {
+		store->set(i,slot,value);
+	}
+}
+
+void CopyNumbers::attach(const std::shared_ptr<CopyNumberStore>& new_store) {
+	if (new_store == store) return;
+	ASSERT(new_store->get_number_of_cells() == size(),"the new store has a different number of subvolumes");
+	const int new_slot = new_store->add_slot();
+	const int n = size();
+	for (int i = 0; i < n; ++i) {
+		new_store->set(i,new_slot,store->get(i,slot));
+	}
+	store->release_slot(slot);
+	store = new_store;
+	slot = new_slot;
+}
+
+}
@@ -0,0 +1,245 @@
+/*
+ * CopyNumbers.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef COPYNUMBERS_H_
+#define COPYNUMBERS_H_
+
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <cstdint>
+#include <limits>
+#include "Log.h"
+
+namespace Tyche {
+
+/*
+ * copy numbers of several species on one grid, stored cell-major: the copy
+ * numbers of all the species in a subvolume are next to each other, so
+ * the propensities of a subvolume are calculated from one or two cache
+ * lines. Each species has a slot in every subvolume. With set_narrow(true)
+ * they are held in 16 bit integers, until one doesn't fit, at which point
+ * all of them are promoted to 32 bit for good.
+ *
+ * With set_paged(true) they are instead held in pages of PAGE_SIZE
+ * subvolumes, which are only allocated once one of their copy numbers
+ * is nonzero, for large grids that are mostly empty.
+ *
+ * Promotion and page allocation aren't thread-safe, so narrow or paged
+ * stores must only be written by one thread at a time.
+ */
+class CopyNumberStore {
+public:
+	static const int PAGE_SHIFT = 9;
+	static const int PAGE_SIZE = 1 << PAGE_SHIFT;
+
+	CopyNumberStore(const int number_of_cells);
+
+	int add_slot();
+	void release_slot(const int slot);
+
+	/*
+	 * use 16 bit copy numbers if all of them fit, returns whether they are
+	 */
+	bool set_narrow(const bool use);
+	bool get_narrow() const {
+		return narrow;
+	}
+	/*
+	 * allocate pages of subvolumes only where there are molecules, a paged
+	 * store is never narrow
+	 */
+	void set_paged(const bool use);
+	bool get_paged() const {
+		return paged;
+	}
+	int get_number_of_pages() const {
+		return pages.size();
+	}
+	bool is_page_allocated(const int p) const {
+		return !pages[p].empty();
+	}
+	/*
+	 * free the pages whose copy numbers are all zero
+	 */
+	void release_empty_pages();
+
+	int get_number_of_cells() const {
+		return number_of_cells;
+	}
+	int get_number_of_slots() const {
+		return stride;
+	}
+	int get(const int cell, const int slot) const {
+		if (paged) {
+			const std::vector<int>& page = pages[cell >> PAGE_SHIFT];
+			return page.empty() ? 0 : page[(cell & (PAGE_SIZE-1))*stride + slot];
+		}
+		const int k = cell*stride + slot;
+		return narrow ? narrow_data[k] : data[k];
+	}
+	void set(const int cell, const int slot, const int value) {
+		if (paged) {
+			std::vector<int>& page = pages[cell >> PAGE_SHIFT];
+			if (page.empty()) {
+				if (value == 0) return;
+				page.assign(PAGE_SIZE*stride,0);
+			}
+			page[(cell & (PAGE_SIZE-1))*stride + slot] = value;
+			return;
+		}
+		const int k = cell*stride + slot;
+		if (narrow) {
+			if ((value >= std::numeric_limits<int16_t>::min()) && (value <= std::numeric_limits<int16_t>::max())) {
+				narrow_data[k] = value;
+				return;
+			}
+			promote();
+		}
+		data[k] = value;
+	}
+	void add(const int cell, const int slot, const int delta) {
+		set(cell,slot,get(cell,slot)+delta);
+	}
+private:
+	void relayout(const int new_stride);
+	void promote();
+
+	int number_of_cells;
+	int stride;
+	bool narrow;
+	bool paged;
+	std::vector<int> data;
+	std::vector<int16_t> narrow_data;
+	std::vector<std::vector<int> > pages;
+	std::vector<int> free_slots;
+};
+
+/*
+ * the copy numbers of one species, a view of its slot in a CopyNumberStore
+ * that reads like a std::vector<int>. A species starts with a store of its
+ * own, operators that want its copy numbers next to those of the other
+ * species on their grid attach it to a shared store.
+ */
+class CopyNumbers {
+public:
+	class Reference {
+	public:
+		Reference(CopyNumberStore& store, const int cell, const int slot):
+			store(store),cell(cell),slot(slot) {}
+		operator int() const {
+			return store.get(cell,slot);
+		}
+		Reference& operator=(const int value) {
+			store.set(cell,slot,value);
+			return *this;
+		}
+		Reference& operator=(const Reference& arg) {
+			return *this = int(arg);
+		}
+		Reference& operator+=(const int delta) {
+			store.add(cell,slot,delta);
+			return *this;
+		}
+		Reference& operator-=(const int delta) {
+			store.add(cell,slot,-delta);
+			return *this;
+		}
+		Reference& operator++() {
+			return *this += 1;
+		}
+		Reference& operator--() {
+			return *this -= 1;
+		}
+		int operator++(int) {
+			const int old = *this;
+			*this += 1;
+			return old;
+		}
+		int operator--(int) {
+			const int old = *this;
+			*this -= 1;
+			return old;
+		}
+	private:
+		CopyNumberStore& store;
+		const int cell;
+		const int slot;
+	};
+
+	class const_iterator: public std::iterator<std::forward_iterator_tag,int,int,const int*,int> {
+	public:
+		const_iterator(const CopyNumbers& copy_numbers, const int cell):
+			copy_numbers(&copy_numbers),cell(cell) {}
+		int operator*() const {
+			return (*copy_numbers)[cell];
+		}
+		const_iterator& operator++() {
+			++cell;
+			return *this;
+		}
+		const_iterator operator++(int) {
+			const_iterator old(*this);
+			++cell;
+			return old;
+		}
+		bool operator==(const const_iterator& arg) const {
+			return cell == arg.cell;
+		}
+		bool operator!=(const const_iterator& arg) const {
+			return cell != arg.cell;
+		}
+	private:
+		const CopyNumbers* copy_numbers;
+		int cell;
+	};
+
+	CopyNumbers();
+	CopyNumbers(const CopyNumbers& arg);
+	CopyNumbers& operator=(const CopyNumbers& arg);
+	~CopyNumbers();
+
+	int operator[](const int cell) const {
+		return store->get(cell,slot);
+	}
+	Reference operator[](const int cell) {
+		return Reference(*store,cell,slot);
+	}
+	int size() const {
+		return store->get_number_of_cells();
+	}
+	const_iterator begin() const {
+		return const_iterator(*this,0);
+	}
+	const_iterator end() const {
+		return const_iterator(*this,size());
+	}
+
+	/*
+	 * set all copy numbers to value, moving to a store of its own if n
+	 * differs from the number of subvolumes of the current one
+	 */
+	void assign(const int n, const int value);
+
+	/*
+	 * move the copy numbers into a slot of new_store, which must have the
+	 * same number of subvolumes
+	 */
+	void attach(const std::shared_ptr<CopyNumberStore>& new_store);
+	const std::shared_ptr<CopyNumberStore>& get_store() const {
+		return store;
+	}
+	int get_slot() const {
+		return slot;
+	}
+private:
+	std::shared_ptr<CopyNumberStore> store;
+	int slot;
+};
+
+}
+
+#endif /* COPYNUMBERS_H_ */
@@ -62,6 +62,7 @@ struct BOOST_PP_CAT(DATA_typename,_Entry) {
 class DATA_typename {
 public:
 	DATA_typename() {}
+	virtual ~DATA_typename() {}
 	void push_back(BOOST_PP_ENUM(DATA_n,DATA_push_back_params, ~)) {
 		BOOST_PP_REPEAT(DATA_n, DATA_push_back_impl, ~)
 	}
@@ -70,7 +71,7 @@ public:
 		BOOST_PP_REPEAT(DATA_n, DATA_pop_back_impl, ~)
 	}
 
-	void clear() {
+	virtual void clear() {
 		BOOST_PP_REPEAT(DATA_n, DATA_clear_impl, ~)
 	}
 
@@ -10,25 +10,76 @@
 #include <boost/foreach.hpp>
 #include <boost/random.hpp>
 #include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace Tyche {
 
 void Diffusion::integrate(const double dt) {
+	static_assert(sizeof(Vect3d) == 3*sizeof(double),"the kernel steps the positions as one array of doubles");
+	if (blocks.is_parallel()) {
+		integrate_in_blocks(dt);
+		return;
+	}
 
 	const int n = get_species().size();
 	for (int i = 0; i < n; ++i) {
 		Species &s = *(get_species()[i]);
 		const Vect3d step_length = calc_step_length(s, dt);
 		const int n = s.mols.size();
+		if (n == 0) continue;
+		kernel.step(s.mols.r[0].data(),s.mols.r0[0].data(),n,step_length);
+		if (!s.mols.has_cell_index()) continue;
 		for (int j = 0; j < n; ++j) {
-			s.mols.r0[j] = s.mols.r[j];
-			s.mols.r[j] += step_length.cwiseProduct(Vect3d(norm(),norm(),norm()));
+			s.mols.update_cell_index(j);
 		}
 	}
 
 }
 
+void Diffusion::reset_execute() {
+	kernel.unseed();
+	number_of_steps = 0;
+}
 
+void Diffusion::integrate_in_blocks(const double dt) {
+	if ((number_of_steps == 0) || (stream_generation != generator_seeds)) {
+		stream_seed = (uint64_t(generator()) << 32) | uint64_t(generator());
+		stream_generation = generator_seeds;
+		number_of_steps = 0;
+	}
+	BOOST_FOREACH(BrownianKernel& k, thread_kernels) {
+		if (k.get_instruction_set() != kernel.get_instruction_set()) k.set_instruction_set(kernel.get_instruction_set());
+	}
+	const int ns = get_species().size();
+	for (int i = 0; i < ns; ++i) {
+		Species &s = *(get_species()[i]);
+		const Vect3d step_length = calc_step_length(s, dt);
+		const int nb = blocks.split(s.mols.size());
+		if (nb == 0) continue;
+		double* r = s.mols.r[0].data();
+		double* r0 = s.mols.r0[0].data();
+		const uint64_t key = stream_seed ^ (number_of_steps*0x9E3779B97F4A7C15ULL) ^ (i*0xD1B54A32D192ED03ULL);
+		#pragma omp parallel for schedule(static) num_threads(blocks.get_number_of_threads())
+		for (int b = 0; b < nb; ++b) {
+#ifdef _OPENMP
+			BrownianKernel& k = thread_kernels[omp_get_thread_num()];
+#else
+			BrownianKernel& k = thread_kernels[0];
+#endif
+			k.seed(key ^ (b*0x8CB92BA72F3D8DD7ULL));
+			const int begin = blocks.begin(b);
+			k.step(r + 3*begin,r0 + 3*begin,blocks.end(b) - begin,step_length);
+		}
+		if (!s.mols.has_cell_index()) continue;
+		const int n = s.mols.size();
+		for (int j = 0; j < n; ++j) {
+			s.mols.update_cell_index(j);
+		}
+	}
+	number_of_steps++;
+}
 
 Diffusion create_diffusion() {
 	return Diffusion();
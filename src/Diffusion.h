@@ -32,28 +32,52 @@
 #include <set>
 #include "MyRandom.h"
 #include "NextSubvolumeMethod.h"
+#include "BrownianKernel.h"
+#include "MoleculeBlocks.h"
 
 namespace Tyche {
 
 
 class Diffusion: public Operator {
 public:
-	Diffusion():norm(generator,boost::normal_distribution<>(0,1)) {}
+	Diffusion():stream_generation(0),number_of_steps(0) {}
 	static std::auto_ptr<Operator> New() {
 		return std::auto_ptr<Operator>(new Diffusion());
 	}
-
+	BrownianKernel& get_kernel() { return kernel; }
+	/*
+	 * step the molecules on n threads, see MoleculeBlocks. Each block of
+	 * molecules takes its normals from its own stream, keyed by a seed
+	 * drawn from the global generator, the step, the species and the
+	 * block, so the result doesn't depend on n (but isn't the same as with
+	 * the single stream used without threads). The seed is drawn again
+	 * after reset() or random_seed()
+	 */
+	void set_number_of_threads(const int n) {
+		blocks.set_number_of_threads(n);
+		thread_kernels.resize(blocks.get_number_of_threads());
+	}
+	int get_number_of_threads() const { return blocks.get_number_of_threads(); }
 
 protected:
 	virtual void integrate(const double dt);
+	virtual void reset_execute();
 	virtual void print(std::ostream& out) const {
 		out << "\tDiffusion";
 	}
 	Vect3d calc_step_length(Species &s, const double dt) {
 		return (2.0*s.D*dt).cwiseSqrt();
 	}
-	boost::variate_generator<base_generator_type&, boost::normal_distribution<> > norm;
+	BrownianKernel kernel;
 	std::vector<int> compartment_rate_indicies;
+
+private:
+	void integrate_in_blocks(const double dt);
+	MoleculeBlocks blocks;
+	std::vector<BrownianKernel> thread_kernels;
+	uint64_t stream_seed;
+	unsigned long stream_generation;
+	unsigned long number_of_steps;
 };
 
 
@@ -78,6 +102,9 @@ public:
 	  indices.insert(neighbrs[j]);
     }
     indices_to_consider = std::vector<int>(indices.begin(), indices.end());
+    tracked_slot.assign(subvolumes.size(), -1);
+    for (int k = 0; k < indices_to_consider.size(); k++)
+      tracked_slot[indices_to_consider[k]] = k;
   };
   static std::auto_ptr<Operator> New(const T& geometry, NextSubvolumeMethod *_nsm) {
     return std::auto_ptr<Operator>(new DiffusionWithTracking(geometry,_nsm));
@@ -90,6 +117,12 @@ private:
   NextSubvolumeMethod *nsm;
 
   std::vector<int> indices_to_consider;
+  /*
+   * slot in indices_to_consider of each cell of the nsm grid (-1 if the
+   * cell isn't tracked), and the copy numbers counted in each slot
+   */
+  std::vector<int> tracked_slot;
+  std::vector<int> copy_numbers;
 };
 
 #include "Diffusion.impl.h"
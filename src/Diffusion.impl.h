@@ -1,34 +1,36 @@
 template<typename T>
 void DiffusionWithTracking<T>::integrate(const double dt) {
-  std::set<int> dirty_indices;
+  /*
+   * step the molecules in chunks of one kernel block and classify each
+   * chunk while it is still in cache
+   */
+  const int chunk = 256;
   const int n = get_species().size();
   for (int i = 0; i < n; ++i) {
     Species &s = *(get_species()[i]);
+    ASSERT(s.grid == &nsm->get_grid(), "species must be on the grid of the nsm");
     const Vect3d step_length = calc_step_length(s, dt);
     const int n = s.mols.size();
-    std::vector<int> copy_numbers(indices_to_consider.size(), 0);
-    for (int j = 0; j < n; ++j) {
-      const Vect3d r0 = s.mols.r[j];
-      const Vect3d r = r0+step_length.cwiseProduct( Vect3d(norm(),norm(),norm()));
-      //const int old_cidx = s.grid->get_cell_index(r0);
-      const int cidx = s.grid->get_cell_index(r);
-      for (int l = 0; l < indices_to_consider.size(); l++) {
-	if (cidx==indices_to_consider[l]) {
-	  copy_numbers[l]++;
-	  break;
+    copy_numbers.assign(indices_to_consider.size(), 0);
+    for (int begin = 0; begin < n; begin += chunk) {
+      const int end = std::min(n, begin + chunk);
+      kernel.step(s.mols.r[begin].data(), s.mols.r0[begin].data(), end - begin, step_length);
+      for (int j = begin; j < end; ++j) {
+	const Vect3d& r = s.mols.r[j];
+	const int cidx = s.grid->is_in(r) ? s.grid->get_cell_index(r) : -1;
+	if (cidx >= 0) {
+	  const int slot = tracked_slot[cidx];
+	  if (slot >= 0) copy_numbers[slot]++;
 	}
+	s.mols.update_cell_index(j,cidx);
       }
-      s.mols.r0[j] = r0;
-      s.mols.r[j] = r;
     }
     for (int k = 0; k < indices_to_consider.size(); k++) {
       const int cidx = indices_to_consider[k];
       if (s.copy_numbers[cidx]!=copy_numbers[k]) {
+	nsm->mark_cell_dirty(cidx);
 	s.copy_numbers[cidx] = copy_numbers[k];
-	dirty_indices.insert(cidx);
       }
     }
   }
-  for (auto i : dirty_indices)
-    nsm->recalc_priority(i);
 }
@@ -0,0 +1,68 @@
+/*
+ * DirtyCells.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef DIRTYCELLS_H_
+#define DIRTYCELLS_H_
+
+#include <vector>
+#include <algorithm>
+#include "Log.h"
+
+namespace Tyche {
+
+/*
+ * the set of subvolumes whose copy numbers were changed by other operators
+ * since the last step, as one flag per subvolume (so marking a subvolume
+ * twice costs nothing) plus the list of marked subvolumes (so clearing
+ * them doesn't touch the rest of the grid). Neither allocates once the
+ * list has grown to the busiest step.
+ */
+class DirtyCells {
+public:
+	DirtyCells(const int number_of_cells = 0):
+		flags(number_of_cells,false) {}
+
+	void mark(const int i) {
+		ASSERT((i >= 0) && (i < int(flags.size())),"subvolume index "<<i<<" out of range");
+		if (flags[i]) return;
+		flags[i] = true;
+		cells.push_back(i);
+	}
+	bool is_marked(const int i) const {
+		return flags[i];
+	}
+	bool empty() const {
+		return cells.empty();
+	}
+
+	/*
+	 * the marked subvolumes in the order they were marked
+	 */
+	const std::vector<int>& get() const {
+		return cells;
+	}
+	/*
+	 * the marked subvolumes in increasing order
+	 */
+	const std::vector<int>& get_sorted() {
+		std::sort(cells.begin(),cells.end());
+		return cells;
+	}
+	void clear() {
+		const int n = cells.size();
+		for (int k = 0; k < n; ++k) {
+			flags[cells[k]] = false;
+		}
+		cells.clear();
+	}
+private:
+	std::vector<bool> flags;
+	std::vector<int> cells;
+};
+
+}
+
+#endif /* DIRTYCELLS_H_ */
@@ -0,0 +1,287 @@
+/*
+ * FiniteVolumeMethod.cpp
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "FiniteVolumeMethod.h"
+#include "StructuredGrid.h"
+#include "Log.h"
+#include <cmath>
+#include <boost/foreach.hpp>
+#include <boost/random/poisson_distribution.hpp>
+
+namespace Tyche {
+
+FiniteVolumeMethod::FiniteVolumeMethod(NextSubvolumeMethod& nsm):
+		nsm(nsm),
+		grid(nsm.get_grid()),
+		to_pde(INFINITY),
+		to_nsm(0),
+		scan_all(false),
+		number_of_solves(0),
+		rows(grid.size(),-1) {
+	CHECK(dynamic_cast<const StructuredGrid*>(&grid) != NULL,"FiniteVolumeMethod needs a StructuredGrid");
+	laplacian.build(grid);
+}
+
+void FiniteVolumeMethod::add_species_execute(Species &s) {
+	nsm.add_species(s);
+	amounts.push_back(std::vector<double>(grid.size(),0));
+}
+
+void FiniteVolumeMethod::reset_execute() {
+	scan_all = to_pde != INFINITY;
+}
+
+void FiniteVolumeMethod::add_reaction(const double rate, ReactionEquation eq) {
+	Reaction r;
+	const int beta = eq.lhs.get_num_reactants();
+	r.rate = rate*pow(grid.get_cell_volume(0),1-beta);
+	BOOST_FOREACH(ReactionComponent rc, eq.lhs) {
+		add_species(*rc.species);
+		const int s_i = get_species_index(*rc.species);
+		r.lhs.push_back(std::make_pair(s_i,rc.multiplier));
+		r.delta.push_back(std::make_pair(s_i,-rc.multiplier));
+	}
+	BOOST_FOREACH(ReactionComponent rc, eq.rhs) {
+		add_species(*rc.species);
+		r.delta.push_back(std::make_pair(get_species_index(*rc.species),rc.multiplier));
+	}
+	reactions.push_back(r);
+}
+
+void FiniteVolumeMethod::set_thresholds(const double to_pde, const double to_nsm) {
+	CHECK(to_nsm < to_pde,"the threshold to leave the regime ("<<to_nsm<<") must be below the one to join it ("<<to_pde<<")");
+	this->to_pde = to_pde;
+	this->to_nsm = to_nsm;
+	nsm.set_watch_changed_cells(true);
+	scan_all = true;
+}
+
+void FiniteVolumeMethod::add_region(const Geometry& geometry) {
+	BOOST_FOREACH(Species* s, nsm.get_species()) {
+		add_species(*s);
+	}
+	std::vector<int> indicies;
+	grid.get_region(geometry,indicies);
+	join(indicies);
+}
+
+std::vector<double> FiniteVolumeMethod::get_amounts(const Species& s) const {
+	s.synchronise();
+	const int n = grid.size();
+	std::vector<double> total(n,0);
+	const int ns = get_species().size();
+	for (int s_i = 0; s_i < ns; ++s_i) {
+		if (get_species()[s_i] != &s) continue;
+		total = amounts[s_i];
+	}
+	for (int i = 0; i < n; ++i) {
+		total[i] += s.copy_numbers[i];
+	}
+	return total;
+}
+
+void FiniteVolumeMethod::join(const std::vector<int>& indicies) {
+	nsm.synchronise();
+	const int ns = get_species().size();
+	std::vector<int> joined;
+	BOOST_FOREACH(int i, indicies) {
+		if (rows[i] >= 0) continue;
+		rows[i] = cells.size();
+		cells.push_back(i);
+		joined.push_back(i);
+		for (int s_i = 0; s_i < ns; ++s_i) {
+			Species& s = *get_species()[s_i];
+			amounts[s_i][i] += s.copy_numbers[i];
+			s.copy_numbers[i] = 0;
+		}
+	}
+	if (joined.empty()) return;
+	nsm.suspend_subvolumes(joined);
+}
+
+void FiniteVolumeMethod::leave(const std::vector<int>& indicies) {
+	nsm.synchronise();
+	const int ns = get_species().size();
+	std::vector<int> left;
+	BOOST_FOREACH(int i, indicies) {
+		const int r = rows[i];
+		if (r < 0) continue;
+		rows[i] = -1;
+		if (r != int(cells.size())-1) {
+			cells[r] = cells.back();
+			rows[cells[r]] = r;
+		}
+		cells.pop_back();
+		left.push_back(i);
+		for (int s_i = 0; s_i < ns; ++s_i) {
+			get_species()[s_i]->copy_numbers[i] += round_randomly(amounts[s_i][i]);
+			amounts[s_i][i] = 0;
+		}
+	}
+	if (left.empty()) return;
+	nsm.resume_subvolumes(left);
+}
+
+/*
+ * move the NSM subvolumes with at least to_pde molecules into the regime,
+ * and those in it with less than to_nsm out. Only the NSM subvolumes that
+ * changed since the last call can have reached to_pde
+ */
+void FiniteVolumeMethod::convert() {
+	if (to_pde == INFINITY) return;
+	const int ns = get_species().size();
+	std::vector<int> joining,leaving;
+	DirtyCells& changed = nsm.get_changed_cells();
+	if (scan_all) {
+		const int n = grid.size();
+		for (int i = 0; i < n; ++i) changed.mark(i);
+		scan_all = false;
+	}
+	BOOST_FOREACH(int i, changed.get_sorted()) {
+		if (rows[i] >= 0) continue;
+		double total = 0;
+		for (int s_i = 0; s_i < ns; ++s_i) total += get_species()[s_i]->copy_numbers[i];
+		if (total >= to_pde) joining.push_back(i);
+	}
+	changed.clear();
+	BOOST_FOREACH(int i, cells) {
+		double total = 0;
+		for (int s_i = 0; s_i < ns; ++s_i) total += amounts[s_i][i];
+		if (total < to_nsm) leaving.push_back(i);
+	}
+	if (!joining.empty()) {
+		LOG(2,"FiniteVolumeMethod: "<<joining.size()<<" subvolumes join the deterministic regime");
+		join(joining);
+	}
+	if (!leaving.empty()) {
+		LOG(2,"FiniteVolumeMethod: "<<leaving.size()<<" subvolumes leave the deterministic regime");
+		leave(leaving);
+	}
+}
+
+/*
+ * collect the molecules that jumped from the NSM into the regime
+ */
+void FiniteVolumeMethod::absorb() {
+	const int ns = get_species().size();
+	BOOST_FOREACH(int i, cells) {
+		for (int s_i = 0; s_i < ns; ++s_i) {
+			Species& s = *get_species()[s_i];
+			const int copy_number = s.copy_numbers[i];
+			if (copy_number == 0) continue;
+			amounts[s_i][i] += copy_number;
+			s.copy_numbers[i] = 0;
+		}
+	}
+}
+
+void FiniteVolumeMethod::react(const double dt) {
+	const int nr = reactions.size();
+	if (nr == 0) return;
+	const int ns = get_species().size();
+	propensities.resize(nr);
+	BOOST_FOREACH(int i, cells) {
+		for (int r = 0; r < nr; ++r) {
+			double propensity = reactions[r].rate;
+			BOOST_FOREACH(const Component& c, reactions[r].lhs) {
+				propensity *= pow(amounts[c.first][i],c.second);
+			}
+			propensities[r] = propensity*dt;
+		}
+		for (int r = 0; r < nr; ++r) {
+			BOOST_FOREACH(const Component& c, reactions[r].delta) {
+				amounts[c.first][i] += c.second*propensities[r];
+			}
+		}
+		for (int s_i = 0; s_i < ns; ++s_i) {
+			amounts[s_i][i] = std::max(0.0,amounts[s_i][i]);
+		}
+	}
+}
+
+void FiniteVolumeMethod::diffuse(const int species_index, const double dt) {
+	Species& s = *get_species()[species_index];
+	std::vector<double>& u = amounts[species_index];
+	if (s.D[0] == 0) return;
+	const double D_dt = s.D[0]*dt;
+	const int n = cells.size();
+	rhs.resize(n);
+	entries.clear();
+	for (int r = 0; r < n; ++r) {
+		const int i = cells[r];
+		double diagonal = 1.0;
+		for (int k = laplacian.offsets[i]; k < laplacian.offsets[i+1]; ++k) {
+			const double coefficient = D_dt*laplacian.coefficients[k];
+			diagonal += coefficient;
+			const int j = laplacian.neighbours[k];
+			if (rows[j] >= 0) entries.push_back(Eigen::Triplet<double>(r,rows[j],-coefficient));
+		}
+		entries.push_back(Eigen::Triplet<double>(r,r,diagonal));
+		rhs[r] = u[i];
+	}
+
+	/*
+	 * conjugate gradients preconditioned with the diagonal, starting from
+	 * the amounts before the step. This needs no factorisation, so the
+	 * matrix is simply assembled again when cells join or leave
+	 */
+	matrix.resize(n,n);
+	matrix.setFromTriplets(entries.begin(),entries.end());
+	solver.setTolerance(1e-10);
+	solver.compute(matrix);
+	solution = solver.solveWithGuess(rhs,rhs);
+	number_of_solves++;
+
+	/*
+	 * the flux into NSM subvolumes has left the solution, send it as
+	 * molecules and keep the rounding difference
+	 */
+	for (int r = 0; r < n; ++r) {
+		const int i = cells[r];
+		double amount = solution[r];
+		for (int k = laplacian.offsets[i]; k < laplacian.offsets[i+1]; ++k) {
+			const int j = laplacian.neighbours[k];
+			if (rows[j] >= 0) continue;
+			const double flux = D_dt*laplacian.coefficients[k]*solution[r];
+			if (flux <= 0) continue;
+			boost::random::poisson_distribution<int> poisson(flux);
+			const int m = std::min(poisson(generator),int(amount + flux));
+			amount += flux - m;
+			if (m == 0) continue;
+			s.copy_numbers[j] += m;
+			nsm.mark_cell_dirty(j);
+		}
+		u[i] = std::max(0.0,amount);
+	}
+}
+
+int FiniteVolumeMethod::round_randomly(const double amount) {
+	const int whole = int(amount);
+	boost::uniform_real<> uni(0,1);
+	return whole + (uni(generator) < amount - whole ? 1 : 0);
+}
+
+void FiniteVolumeMethod::integrate(const double dt) {
+	nsm.synchronise();
+	BOOST_FOREACH(Species* s, nsm.get_species()) {
+		add_species(*s);
+	}
+	if (!cells.empty()) {
+		absorb();
+		react(dt);
+		const int ns = get_species().size();
+		for (int s_i = 0; s_i < ns; ++s_i) {
+			diffuse(s_i,dt);
+		}
+	}
+	convert();
+}
+
+void FiniteVolumeMethod::print(std::ostream& out) const {
+	out << "\tFinite Volume Method ("<<cells.size()<<" subvolumes, "<<number_of_solves<<" solves)";
+}
+
+}
@@ -0,0 +1,131 @@
+/*
+ * FiniteVolumeMethod.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef FINITEVOLUMEMETHOD_H_
+#define FINITEVOLUMEMETHOD_H_
+
+#include "Operator.h"
+#include "NextSubvolumeMethod.h"
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+#include "Eigen/IterativeLinearSolvers"
+#include <vector>
+#include <memory>
+
+namespace Tyche {
+
+/*
+ * deterministic regime for subvolumes of a NextSubvolumeMethod on a
+ * StructuredGrid where the copy numbers are so large that even the NSM is
+ * too expensive. The subvolumes in the regime are suspended in the NSM,
+ * and this operator holds their amounts (as real numbers of molecules) and
+ * steps the reaction-diffusion equation with finite volumes: reactions
+ * explicitly, then diffusion with one implicit solve per species
+ *
+ *     (1 + D*dt*sum_j L_ij) u_i - D*dt*sum_j' L_ij' u_j' = u_i
+ *
+ * where j runs over all neighbours and j' over those in the regime. The
+ * solve uses Eigen's conjugate gradients preconditioned with the diagonal,
+ * so nothing is factorised and subvolumes join and leave without more
+ * than assembling the sparse matrix again.
+ *
+ * The interface works like set_interface between compartments and
+ * molecules: the NSM jumps into the regime are left in place and the
+ * molecules they deliver are absorbed at the start of each step, and the
+ * flux D*dt*L_ij*u_i from a subvolume i in the regime into an NSM
+ * neighbour j is delivered as a Poisson number of molecules added to the
+ * copy numbers of j. The difference between the flux and the molecules
+ * sent stays in i, so the total number of molecules is conserved.
+ *
+ * Subvolumes join the regime with add_region, or, after set_thresholds,
+ * when the total copy number of an NSM subvolume reaches to_pde, and leave
+ * it when their total amount falls below to_nsm. Only the subvolumes the
+ * NSM reports as changed are checked for joining (see
+ * NextSubvolumeMethod::set_watch_changed_cells). The NSM reactions should
+ * also be added here, and every species of the NSM is simulated. Put this
+ * operator and the NSM in an OperatorList.
+ */
+class FiniteVolumeMethod: public Operator {
+public:
+	FiniteVolumeMethod(NextSubvolumeMethod& nsm);
+	static std::auto_ptr<FiniteVolumeMethod> New(NextSubvolumeMethod& nsm) {
+		return std::auto_ptr<FiniteVolumeMethod>(new FiniteVolumeMethod(nsm));
+	}
+
+	/*
+	 * mass action reaction with the same rate as NextSubvolumeMethod::add_reaction
+	 */
+	void add_reaction(const double rate, ReactionEquation eq);
+	/*
+	 * move the subvolumes in geometry into the regime now
+	 */
+	void add_region(const Geometry& geometry);
+	void set_thresholds(const double to_pde, const double to_nsm);
+	/*
+	 * amount of s in each subvolume, from the regime or the NSM copy numbers
+	 */
+	std::vector<double> get_amounts(const Species& s) const;
+	int get_number_of_cells() const { return cells.size(); }
+	unsigned long get_number_of_solves() const { return number_of_solves; }
+
+protected:
+	virtual void add_species_execute(Species &s);
+	virtual void reset_execute();
+	virtual void integrate(const double dt);
+	virtual void print(std::ostream& out) const;
+
+private:
+	void join(const std::vector<int>& indicies);
+	void leave(const std::vector<int>& indicies);
+	void convert();
+	void absorb();
+	void react(const double dt);
+	void diffuse(const int species_index, const double dt);
+	int round_randomly(const double amount);
+
+	NextSubvolumeMethod& nsm;
+	const Grid& grid;
+	double to_pde,to_nsm;
+	bool scan_all;
+	unsigned long number_of_solves;
+
+	/*
+	 * the subvolumes in the regime, and the row of each subvolume in the
+	 * matrices (-1 if it is not in the regime)
+	 */
+	std::vector<int> cells;
+	std::vector<int> rows;
+
+	GridNeighbours laplacian;
+
+	/*
+	 * per species, the amount in every subvolume (zero outside the regime),
+	 * and the matrix, solver and vectors for the solve
+	 */
+	std::vector<std::vector<double> > amounts;
+	typedef Eigen::SparseMatrix<double> Matrix;
+	std::vector<Eigen::Triplet<double> > entries;
+	Matrix matrix;
+	Eigen::ConjugateGradient<Matrix> solver;
+	Eigen::VectorXd rhs,solution;
+
+	/*
+	 * rate (scaled by the subvolume volume), lhs and change in amount of
+	 * each reaction, as (species index, number)
+	 */
+	typedef std::pair<int,int> Component;
+	struct Reaction {
+		double rate;
+		std::vector<Component> lhs;
+		std::vector<Component> delta;
+	};
+	std::vector<Reaction> reactions;
+	std::vector<double> propensities;
+};
+
+}
+
+#endif /* FINITEVOLUMEMETHOD_H_ */
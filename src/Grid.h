@@ -54,6 +54,34 @@ public:
   virtual double get_laplace_coefficient(const int i, const int j) const = 0;
   virtual double get_distance_between(const int i, const int j) const = 0;
 };
+
+/*
+ * neighbours of every cell of a grid with the laplace coefficients to them,
+ * in compressed rows: the neighbours of cell i are neighbours[offsets[i]]
+ * to neighbours[offsets[i+1]-1], with coefficients in coefficients
+ */
+struct GridNeighbours {
+  void build(const Grid& grid) {
+    const int n = grid.size();
+    offsets.resize(n+1);
+    neighbours.clear();
+    coefficients.clear();
+    offsets[0] = 0;
+    for (int i = 0; i < n; ++i) {
+      const std::vector<int> neighbrs = grid.get_neighbour_indicies(i);
+      const int nn = neighbrs.size();
+      for (int j = 0; j < nn; ++j) {
+        neighbours.push_back(neighbrs[j]);
+        coefficients.push_back(grid.get_laplace_coefficient(i,neighbrs[j]));
+      }
+      offsets[i+1] = neighbours.size();
+    }
+  }
+
+  std::vector<int> offsets;
+  std::vector<int> neighbours;
+  std::vector<double> coefficients;
+};
 }
 
 #endif /* GRID_H_ */
@@ -0,0 +1,147 @@
+/*
+ * IndexedHeap.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef INDEXEDHEAP_H_
+#define INDEXEDHEAP_H_
+
+#include <vector>
+#include <algorithm>
+#include "Log.h"
+
+namespace Tyche {
+
+/*
+ * Array-backed D-ary heap of nodes keyed by subvolume index. The position of
+ * every subvolume in the node array is stored in a flat lookup table, so
+ * update/erase by subvolume index need no handles and no pointer chasing.
+ *
+ * T must provide operator< (with the highest priority node being the
+ * largest) and an integer member subvolume_index.
+ */
+template<typename T, unsigned int D>
+class IndexedHeap {
+public:
+	void reset(const int n) {
+		nodes.clear();
+		positions.assign(n,-1);
+	}
+	void clear() {
+		for (typename std::vector<T>::iterator i=nodes.begin();i!=nodes.end();i++) {
+			positions[i->subvolume_index] = -1;
+		}
+		nodes.clear();
+	}
+	bool empty() const {
+		return nodes.empty();
+	}
+	int size() const {
+		return nodes.size();
+	}
+	const T& top() const {
+		return nodes[0];
+	}
+	bool contains(const int i) const {
+		return positions[i] >= 0;
+	}
+	const T& get(const int i) const {
+		ASSERT(contains(i),"subvolume "<<i<<" is not in the heap");
+		return nodes[positions[i]];
+	}
+	void push(const T& node) {
+		ASSERT(!contains(node.subvolume_index),"subvolume "<<node.subvolume_index<<" is already in the heap");
+		nodes.push_back(node);
+		sift_up(nodes.size()-1);
+	}
+	void update(const T& node) {
+		const int p = positions[node.subvolume_index];
+		ASSERT(p >= 0,"subvolume "<<node.subvolume_index<<" is not in the heap");
+		if (nodes[p] < node) {
+			nodes[p] = node;
+			sift_up(p);
+		} else {
+			nodes[p] = node;
+			sift_down(p);
+		}
+	}
+	/*
+	 * replace the contents of the heap with new_nodes, heapifying them
+	 * bottom up in O(n) rather than pushing them one by one. new_nodes is
+	 * left holding the old contents, so that its storage can be reused
+	 */
+	void swap(std::vector<T>& new_nodes) {
+		for (typename std::vector<T>::iterator i=nodes.begin();i!=nodes.end();i++) {
+			positions[i->subvolume_index] = -1;
+		}
+		nodes.swap(new_nodes);
+		const int n = nodes.size();
+		for (int p = 0; p < n; ++p) {
+			ASSERT(!contains(nodes[p].subvolume_index),"subvolume "<<nodes[p].subvolume_index<<" is already in the heap");
+			positions[nodes[p].subvolume_index] = p;
+		}
+		for (int p = n > 1 ? (n-2)/int(D) : -1; p >= 0; --p) {
+			sift_down(p);
+		}
+	}
+	void erase(const int i) {
+		const int p = positions[i];
+		ASSERT(p >= 0,"subvolume "<<i<<" is not in the heap");
+		positions[i] = -1;
+		const int last = nodes.size()-1;
+		if (p != last) {
+			const T moved = nodes[last];
+			nodes.pop_back();
+			if (nodes[p] < moved) {
+				nodes[p] = moved;
+				sift_up(p);
+			} else {
+				nodes[p] = moved;
+				sift_down(p);
+			}
+		} else {
+			nodes.pop_back();
+		}
+	}
+
+private:
+	void sift_up(int p) {
+		const T node = nodes[p];
+		while (p > 0) {
+			const int parent = (p-1)/D;
+			if (!(nodes[parent] < node)) break;
+			nodes[p] = nodes[parent];
+			positions[nodes[p].subvolume_index] = p;
+			p = parent;
+		}
+		nodes[p] = node;
+		positions[node.subvolume_index] = p;
+	}
+	void sift_down(int p) {
+		const T node = nodes[p];
+		const int n = nodes.size();
+		while (true) {
+			const int first_child = D*p+1;
+			if (first_child >= n) break;
+			const int last_child = std::min(first_child+int(D),n);
+			int best = first_child;
+			for (int c = first_child+1; c < last_child; ++c) {
+				if (nodes[best] < nodes[c]) best = c;
+			}
+			if (!(node < nodes[best])) break;
+			nodes[p] = nodes[best];
+			positions[nodes[p].subvolume_index] = p;
+			p = best;
+		}
+		nodes[p] = node;
+		positions[node.subvolume_index] = p;
+	}
+
+	std::vector<T> nodes;
+	std::vector<int> positions;
+};
+
+}
+
+#endif /* INDEXEDHEAP_H_ */
@@ -0,0 +1,116 @@
+/*
+ * LatticeDiffusion.cpp
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "LatticeDiffusion.h"
+#include "Log.h"
+#include <cmath>
+#include <boost/random/binomial_distribution.hpp>
+
+namespace Tyche {
+
+LatticeDiffusion::LatticeDiffusion(Grid& grid):
+		grid(grid),
+		nsm(NULL),
+		number_of_jumps(0) {
+	build_neighbours();
+}
+
+LatticeDiffusion::LatticeDiffusion(NextSubvolumeMethod& nsm):
+		grid(nsm.get_grid()),
+		nsm(&nsm),
+		number_of_jumps(0) {
+	build_neighbours();
+}
+
+void LatticeDiffusion::add_species_execute(Species &s) {
+	if (s.grid == NULL) s.set_grid(&grid);
+	CHECK(s.grid == &grid,"Species ("<<s.id<<") has copy numbers on another grid");
+	probabilities.push_back(JumpProbabilities());
+}
+
+void LatticeDiffusion::reset_execute() {
+	build_neighbours();
+	probabilities.assign(get_species().size(),JumpProbabilities());
+}
+
+void LatticeDiffusion::build_neighbours() {
+	laplacian.build(grid);
+	incoming.assign(grid.size(),0);
+}
+
+void LatticeDiffusion::calculate_probabilities(const int species_index, const double dt) {
+	JumpProbabilities& p = probabilities[species_index];
+	const double D = get_species()[species_index]->D[0];
+	const int n = grid.size();
+	p.dt = dt;
+	p.leave.resize(n);
+	p.split.resize(laplacian.neighbours.size());
+	double max_rate = 0;
+	for (int i = 0; i < n; ++i) {
+		double remaining = 0;
+		for (int k = laplacian.offsets[i]; k < laplacian.offsets[i+1]; ++k) {
+			remaining += laplacian.coefficients[k];
+		}
+		max_rate = std::max(max_rate,D*remaining);
+		p.leave[i] = 1.0 - exp(-D*remaining*dt);
+		for (int k = laplacian.offsets[i]; k < laplacian.offsets[i+1]; ++k) {
+			p.split[k] = remaining > 0 ? std::min(1.0,laplacian.coefficients[k]/remaining) : 0;
+			remaining -= laplacian.coefficients[k];
+		}
+	}
+	if (max_rate*dt > 0.5) {
+		LOG(1,"LatticeDiffusion: timestep "<<dt<<" is not small compared with the mean time between jumps "<<1.0/max_rate);
+	}
+}
+
+void LatticeDiffusion::integrate(const double dt) {
+	const int n = grid.size();
+	const int ns = get_species().size();
+	for (int s_i = 0; s_i < ns; ++s_i) {
+		Species& s = *get_species()[s_i];
+		s.synchronise();
+		if (probabilities[s_i].dt != dt) calculate_probabilities(s_i,dt);
+		const JumpProbabilities& p = probabilities[s_i];
+
+		/*
+		 * molecules leave from the copy numbers at the start of the step,
+		 * the arrivals are added once every subvolume has been split
+		 */
+		for (int i = 0; i < n; ++i) {
+			const int copy_number = s.copy_numbers[i];
+			if (copy_number == 0) continue;
+			boost::random::binomial_distribution<int> leave(copy_number,p.leave[i]);
+			const int out = leave(generator);
+			if (out == 0) continue;
+			int remaining = out;
+			const int last = laplacian.offsets[i+1]-1;
+			for (int k = laplacian.offsets[i]; (k <= last) && (remaining > 0); ++k) {
+				int m = remaining;
+				if (k < last) {
+					boost::random::binomial_distribution<int> split(remaining,p.split[k]);
+					m = split(generator);
+				}
+				incoming[laplacian.neighbours[k]] += m;
+				remaining -= m;
+			}
+			s.copy_numbers[i] = copy_number - out;
+			number_of_jumps += out;
+			if (nsm != NULL) nsm->mark_cell_dirty(i);
+		}
+		for (int i = 0; i < n; ++i) {
+			if (incoming[i] == 0) continue;
+			s.copy_numbers[i] += incoming[i];
+			incoming[i] = 0;
+			if (nsm != NULL) nsm->mark_cell_dirty(i);
+		}
+	}
+}
+
+void LatticeDiffusion::print(std::ostream& out) const {
+	out << "\tLattice Diffusion ("<<number_of_jumps<<" jumps)";
+}
+
+}
@@ -0,0 +1,76 @@
+/*
+ * LatticeDiffusion.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef LATTICEDIFFUSION_H_
+#define LATTICEDIFFUSION_H_
+
+#include "Operator.h"
+#include "NextSubvolumeMethod.h"
+#include <vector>
+
+namespace Tyche {
+
+/*
+ * multiparticle diffusion of the copy numbers on a grid (StructuredGrid or
+ * OctreeGrid), for species with copy numbers too large to diffuse one
+ * jump at a time. Each timestep, the molecules of a species in subvolume i
+ * leave with probability 1-exp(-R_i dt), where R_i = D*sum_j L_ij is the
+ * total rate of the NSM jumps out of i (L_ij from get_laplace_coefficient),
+ * and are split multinomially between the neighbours j in proportion to
+ * L_ij. Molecules jump at most once per timestep, so dt must be small
+ * compared with 1/R_i.
+ *
+ * To react these species with the NSM, add their reactions (but not their
+ * diffusion) to it and put both operators in an OperatorList. The
+ * subvolumes whose copy numbers changed are marked dirty in the NSM.
+ */
+class LatticeDiffusion: public Operator {
+public:
+	LatticeDiffusion(Grid& grid);
+	LatticeDiffusion(NextSubvolumeMethod& nsm);
+	static std::auto_ptr<LatticeDiffusion> New(Grid& grid) {
+		return std::auto_ptr<LatticeDiffusion>(new LatticeDiffusion(grid));
+	}
+	static std::auto_ptr<LatticeDiffusion> New(NextSubvolumeMethod& nsm) {
+		return std::auto_ptr<LatticeDiffusion>(new LatticeDiffusion(nsm));
+	}
+
+	unsigned long get_number_of_jumps() const { return number_of_jumps; }
+
+protected:
+	virtual void add_species_execute(Species &s);
+	virtual void reset_execute();
+	virtual void integrate(const double dt);
+	virtual void print(std::ostream& out) const;
+
+private:
+	void build_neighbours();
+	void calculate_probabilities(const int species_index, const double dt);
+
+	const Grid& grid;
+	NextSubvolumeMethod* nsm;
+	unsigned long number_of_jumps;
+
+	GridNeighbours laplacian;
+
+	/*
+	 * per species, the probability of leaving each subvolume and the
+	 * conditional probability of jumping to each neighbour given that the
+	 * molecule didn't jump to an earlier one, for timestep dt
+	 */
+	struct JumpProbabilities {
+		JumpProbabilities():dt(0) {}
+		double dt;
+		std::vector<double> leave;
+		std::vector<double> split;
+	};
+	std::vector<JumpProbabilities> probabilities;
+	std::vector<int> incoming;
+};
+
+}
+
+#endif /* LATTICEDIFFUSION_H_ */
@@ -0,0 +1,81 @@
+/*
+ * MoleculeBlocks.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef MOLECULEBLOCKS_H_
+#define MOLECULEBLOCKS_H_
+
+#include <vector>
+#include <algorithm>
+#include "Log.h"
+
+namespace Tyche {
+
+/*
+ * the molecules of a species split into blocks of BLOCK_SIZE, for the
+ * operators that go through every molecule on several (OpenMP) threads.
+ * Each block is handled by one thread and lists the molecules it changed
+ * (moved or deleted), and the lists are merged in block order, i.e. in
+ * molecule order, so the result doesn't depend on the number of threads.
+ * With no threads set (the default) there is a single block.
+ */
+class MoleculeBlocks {
+public:
+	static const int BLOCK_SIZE = 4096;
+
+	MoleculeBlocks():number_of_threads(0),number_of_molecules(0),number_of_blocks(0) {}
+
+	void set_number_of_threads(const int n) {
+		CHECK(n >= 0,"number of threads must not be negative");
+		number_of_threads = n;
+	}
+	int get_number_of_threads() const { return std::max(1,number_of_threads); }
+	bool is_parallel() const { return number_of_threads > 0; }
+
+	/*
+	 * split n molecules, emptying the lists. Returns the number of blocks
+	 */
+	int split(const int n) {
+		number_of_molecules = n;
+		number_of_blocks = is_parallel() ? (n + BLOCK_SIZE - 1)/BLOCK_SIZE : std::min(n,1);
+		if (int(lists.size()) < number_of_blocks) lists.resize(number_of_blocks);
+		for (int b = 0; b < number_of_blocks; ++b) {
+			lists[b].clear();
+		}
+		return number_of_blocks;
+	}
+	int begin(const int block) const {
+		return is_parallel() ? block*BLOCK_SIZE : 0;
+	}
+	int end(const int block) const {
+		return is_parallel() ? std::min(number_of_molecules,(block+1)*BLOCK_SIZE) : number_of_molecules;
+	}
+	std::vector<int>& get_list(const int block) {
+		return lists[block];
+	}
+
+	/*
+	 * the listed molecules of all the blocks, in order
+	 */
+	const std::vector<int>& merge() {
+		if (number_of_blocks == 1) return lists[0];
+		merged.clear();
+		for (int b = 0; b < number_of_blocks; ++b) {
+			merged.insert(merged.end(),lists[b].begin(),lists[b].end());
+		}
+		return merged;
+	}
+
+private:
+	int number_of_threads;
+	int number_of_molecules;
+	int number_of_blocks;
+	std::vector<std::vector<int> > lists;
+	std::vector<int> merged;
+};
+
+}
+
+#endif /* MOLECULEBLOCKS_H_ */
@@ -31,6 +31,11 @@ namespace Tyche {
 //typedef boost::minstd_rand base_generator_type;
 typedef boost::mt19937  base_generator_type;
 extern base_generator_type generator;
+/*
+ * number of times the generator has been seeded (by init or random_seed),
+ * so that streams seeded from it can tell they must be seeded again
+ */
+extern unsigned long generator_seeds;
 }
 
 
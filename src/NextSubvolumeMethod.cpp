@@ -9,12 +9,18 @@
 #include "Log.h"
 #include "Constants.h"
 #include <sstream>
+#include <map>
+#include <algorithm>
 #include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
 
 namespace Tyche {
-bool ReactionsWithSameRateAndLHS::add_if_same_lhs(const double rate_to_add, const ReactionSide& lhs_to_add, const ReactionSide& rhs_to_add) {
+bool ReactionsWithSameRateAndLHS::add_if_same_lhs(const double rate_to_add, const ReactionSide& lhs_to_add, const ReactionSide& rhs_to_add,
+		const RateParameter* parameter_to_add) {
 	//std::sort(lhs_to_add);
-	if ((lhs_to_add == lhs)&&(rate_to_add == rate)) {
+	if ((lhs_to_add == lhs)&&(rate_to_add == rate)&&(parameter_to_add == parameter)&&(!is_aggregated())) {
 		all_rhs.push_back(rhs_to_add);
 		//			if (lhs[0].compartment_index==0) {
 		//				std::cout<<"found duplicate lhs, adding new rhs with ci = "<<rhs_to_add[0].compartment_index<<". new all_rhs.size() = "<<all_rhs.size()<<std::endl;
@@ -25,113 +31,613 @@ bool ReactionsWithSameRateAndLHS::add_if_same_lhs(const double rate_to_add, cons
 	}
 }
 
-ReactionSide& ReactionsWithSameRateAndLHS::pick_random_rhs(const double rand) {
+void ReactionsWithSameRateAndLHS::add_aggregated_rhs(const double rate_to_add, const ReactionSide& rhs_to_add) {
+	ASSERT(is_aggregated() || all_rhs.empty(), "cannot add an aggregated rhs to a channel with a single rate");
+	all_rhs.push_back(rhs_to_add);
+	rate += rate_to_add;
+	rhs_cdf.push_back(rate);
+}
+
+double ReactionsWithSameRateAndLHS::erase_rhs(const int j) {
+	double erased_rate = rate;
+	if (is_aggregated()) {
+		erased_rate = rhs_cdf[j] - (j > 0 ? rhs_cdf[j-1] : 0);
+		rhs_cdf.erase(rhs_cdf.begin() + j);
+		const int n = rhs_cdf.size();
+		for (int k = j; k < n; ++k) {
+			rhs_cdf[k] -= erased_rate;
+		}
+		rate = n > 0 ? rhs_cdf[n-1] : 0;
+	}
+	all_rhs.erase(all_rhs.begin() + j);
+	return erased_rate;
+}
+
+int ReactionsWithSameRateAndLHS::pick_random_rhs_index(const double rand) const {
 	const int n = all_rhs.size();
-	if (n==1) return all_rhs[0];
-	return all_rhs[int(floor(rand*n))];
+	if (n==1) return 0;
+	if (is_aggregated()) {
+		const double rand_times_rate = rand*rate;
+		for (int j = 0; j < n-1; ++j) {
+			if (rand_times_rate < rhs_cdf[j]) return j;
+		}
+		return n-1;
+	}
+	return int(floor(rand*n));
+}
+
+ReactionSide& ReactionsWithSameRateAndLHS::pick_random_rhs(const double rand) {
+	return all_rhs[pick_random_rhs_index(rand)];
+}
+
+/*
+ * ReactionComponent ignores tmp, but two subvolumes can only share an
+ * interface reaction if its interface data is the same
+ */
+static bool same_interface_data(const ReactionSide& a, const ReactionSide& b) {
+	const int n = a.size();
+	for (int k = 0; k < n; ++k) {
+		if ((a[k].compartment_index < -INTERFACE_OFFSET/2) && (a[k].tmp != b[k].tmp)) return false;
+	}
+	return true;
+}
+
+bool ReactionsWithSameRateAndLHS::operator==(const ReactionsWithSameRateAndLHS& arg) const {
+	if (!((rate == arg.rate) && (parameter == arg.parameter) && (lhs == arg.lhs) &&
+			(all_rhs == arg.all_rhs) && (rhs_cdf == arg.rhs_cdf))) return false;
+	if (!same_interface_data(lhs,arg.lhs)) return false;
+	const int n_r = all_rhs.size();
+	for (int j = 0; j < n_r; ++j) {
+		if (!same_interface_data(all_rhs[j],arg.all_rhs[j])) return false;
+	}
+	return true;
+}
+
+
+
+static void hash_side(std::size_t& seed, const ReactionSide& side) {
+	BOOST_FOREACH(const ReactionComponent& rc, side) {
+		boost::hash_combine(seed,rc.species);
+		boost::hash_combine(seed,rc.multiplier);
+		boost::hash_combine(seed,rc.compartment_index);
+	}
+	boost::hash_combine(seed,side.size());
+}
+
+static const ReactionSide& sorted_side(const ReactionSide& side, ReactionSide& buffer) {
+	if (std::is_sorted(side.begin(),side.end())) return side;
+	buffer = side;
+	std::sort(buffer.begin(),buffer.end());
+	return buffer;
+}
+
+void ReactionIndex::insert(const std::size_t key, const int reaction) {
+	if (2*(size+1) > int(slots.size())) rehash(std::max(8,2*int(slots.size())));
+	const int mask = slots.size()-1;
+	int slot = key & mask;
+	while (slots[slot].reaction >= 0) slot = (slot+1) & mask;
+	slots[slot].key = key;
+	slots[slot].reaction = reaction;
+	size++;
+}
+
+void ReactionIndex::erase(const std::size_t key, const int reaction) {
+	int hole = -1;
+	for (int r = next(key,hole); r != reaction; r = next(key,hole)) {
+		ASSERT(r >= 0,"reaction "<<reaction<<" is not in the index");
+		if (r < 0) return;
+	}
+
+	/*
+	 * move later entries of the probe sequence back into the hole, so that
+	 * no lookup stops early at it
+	 */
+	const int mask = slots.size()-1;
+	for (int slot = (hole+1) & mask; slots[slot].reaction >= 0; slot = (slot+1) & mask) {
+		const int home = slots[slot].key & mask;
+		const bool home_in_gap = hole <= slot ? (home > hole) && (home <= slot) : (home > hole) || (home <= slot);
+		if (!home_in_gap) {
+			slots[hole] = slots[slot];
+			hole = slot;
+		}
+	}
+	slots[hole] = Slot();
+	size--;
+}
+
+void ReactionIndex::replace(const std::size_t key, const int old_reaction, const int new_reaction) {
+	int slot = -1;
+	for (int r = next(key,slot); r != old_reaction; r = next(key,slot)) {
+		ASSERT(r >= 0,"reaction "<<old_reaction<<" is not in the index");
+		if (r < 0) return;
+	}
+	slots[slot].reaction = new_reaction;
+}
+
+void ReactionIndex::rehash(const int capacity) {
+	std::vector<Slot> old_slots(capacity);
+	old_slots.swap(slots);
+	size = 0;
+	BOOST_FOREACH(const Slot& slot, old_slots) {
+		if (slot.reaction >= 0) insert(slot.key,slot.reaction);
+	}
+}
+
+
+
+void ReactionTemplate::add_reaction(const double rate, const ReactionEquation& eq, const RateParameter* parameter) {
+	ReactionSide buffer;
+	const ReactionSide& sorted_lhs = sorted_side(eq.lhs,buffer);
+	if (!indexed) build_index();
+	const int i = find_channel(sorted_lhs,rate,false,parameter);
+	if (i < 0) {
+		index.insert(lhs_key(sorted_lhs),reactions.size());
+		reactions.push_back(ReactionsWithSameRateAndLHS(rate, sorted_lhs, eq.rhs, parameter));
+	} else {
+		reactions[i].add_if_same_lhs(rate, sorted_lhs, eq.rhs, parameter);
+	}
+	my_size++;
+	compiled = false;
+}
+
+void ReactionTemplate::add_aggregated_reaction(const double rate, const ReactionEquation& eq) {
+	ReactionSide buffer;
+	const ReactionSide& sorted_lhs = sorted_side(eq.lhs,buffer);
+	if (!indexed) build_index();
+	int i = find_channel(sorted_lhs,rate,true,NULL);
+	if (i < 0) {
+		i = reactions.size();
+		index.insert(lhs_key(sorted_lhs),i);
+		reactions.push_back(ReactionsWithSameRateAndLHS(sorted_lhs));
+	}
+	reactions[i].add_aggregated_rhs(rate, eq.rhs);
+	my_size++;
+	compiled = false;
+}
+
+bool ReactionTemplate::find_reaction(const ReactionEquation& eq, int& i, int& j) const {
+	ReactionSide buffer;
+	const ReactionSide& sorted_lhs = sorted_side(eq.lhs,buffer);
+	if (!indexed) build_index();
+	const std::size_t key = lhs_key(sorted_lhs);
+	int slot = -1;
+	for (i = index.next(key,slot); i >= 0; i = index.next(key,slot)) {
+		const ReactionsWithSameRateAndLHS& rs = reactions[i];
+		if (rs.lhs != sorted_lhs) continue;
+		const int n_r = rs.all_rhs.size();
+		for (j = 0; j < n_r; ++j) {
+			if (rs.all_rhs[j] == eq.rhs) return true;
+		}
+	}
+	return false;
+}
+
+double ReactionTemplate::delete_reaction(const ReactionEquation& eq) {
+	int i,j;
+	if (!find_reaction(eq,i,j)) return 0;
+	return erase_reaction(i,j);
+}
+
+double ReactionTemplate::erase_reaction(const int i, const int j) {
+	const double rate = reactions[i].erase_rhs(j);
+	if (reactions[i].all_rhs.size() == 0) {
+		erase_channel(i);
+	}
+	my_size--;
+	compiled = false;
+	return rate;
+}
+
+double ReactionTemplate::scale_reaction(const ReactionEquation& eq, const double factor) {
+	int i,j;
+	if (!find_reaction(eq,i,j)) return 0;
+	ReactionsWithSameRateAndLHS& rs = reactions[i];
+	if (!rs.is_aggregated()) {
+		const RateParameter* parameter = rs.parameter;
+		const double rate = erase_reaction(i,j);
+		add_reaction(rate*factor,eq,parameter);
+		return rate;
+	}
+
+	/*
+	 * an aggregated rhs keeps its place, only the cumulative rates after
+	 * it change
+	 */
+	const double rate = rs.rhs_cdf[j] - (j > 0 ? rs.rhs_cdf[j-1] : 0);
+	const double change = rate*(factor-1);
+	const int n_r = rs.rhs_cdf.size();
+	for (int k = j; k < n_r; ++k) {
+		rs.rhs_cdf[k] += change;
+	}
+	rs.rate = rs.rhs_cdf[n_r-1];
+	compiled = false;
+	return rate;
+}
+
+void ReactionTemplate::erase_channel(const int i) {
+	/*
+	 * the last channel takes the place of the erased one, so that only its
+	 * index entry needs updating
+	 */
+	if (!indexed) build_index();
+	const int last = reactions.size()-1;
+	index.erase(lhs_key(reactions[i].lhs),i);
+	if (i != last) {
+		index.replace(lhs_key(reactions[last].lhs),last,i);
+		std::swap(reactions[i],reactions[last]);
+	}
+	reactions.pop_back();
+}
+
+int ReactionTemplate::find_channel(const ReactionSide& sorted_lhs, const double rate, const bool aggregated, const RateParameter* parameter) const {
+	const std::size_t key = lhs_key(sorted_lhs);
+	int slot = -1;
+	for (int i = index.next(key,slot); i >= 0; i = index.next(key,slot)) {
+		const ReactionsWithSameRateAndLHS& rs = reactions[i];
+		if ((rs.is_aggregated() == aggregated) && (rs.parameter == parameter) && (rs.lhs == sorted_lhs) && (aggregated || (rs.rate == rate))) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+std::size_t ReactionTemplate::lhs_key(const ReactionSide& sorted_lhs) {
+	std::size_t seed = 0;
+	hash_side(seed,sorted_lhs);
+	return seed;
+}
+
+void ReactionTemplate::build_index() const {
+	index.clear();
+	const int n = reactions.size();
+	for (int i = 0; i < n; ++i) {
+		index.insert(lhs_key(reactions[i].lhs),i);
+	}
+	indexed = true;
+}
+
+void ReactionTemplate::index_lhs(const std::vector<int>& species_slots, const int number_of_slots, const int base, const int cell) {
+	lhs_offsets.assign(number_of_slots+1,0);
+	lhs_reactions.clear();
+	remote_lhs = false;
+	unindexed_lhs = false;
+	const int n = reactions.size();
+	for (int pass = 0; pass < 2; ++pass) {
+		std::vector<int> next(lhs_offsets.begin(),lhs_offsets.end()-1);
+		if (pass == 1) lhs_reactions.resize(lhs_offsets[number_of_slots]);
+		for (int i = 0; i < n; ++i) {
+			if (reactions[i].lhs.empty()) unindexed_lhs = true;
+			BOOST_FOREACH(const ReactionComponent& rc, reactions[i].lhs) {
+				const int c = from_template_index(rc.compartment_index,base);
+				const int id = rc.species->id;
+				if ((c != cell) && (c != -cell)) {
+					remote_lhs = true;
+				} else if ((id < int(species_slots.size())) && (species_slots[id] >= 0)) {
+					if (pass == 0) {
+						lhs_offsets[species_slots[id]+1]++;
+					} else {
+						lhs_reactions[next[species_slots[id]]++] = i;
+					}
+				} else {
+					unindexed_lhs = true;
+				}
+			}
+		}
+		if (pass == 0) {
+			for (int s = 0; s < number_of_slots; ++s) {
+				lhs_offsets[s+1] += lhs_offsets[s];
+			}
+		}
+	}
+}
+
+void ReactionTemplate::compile() {
+	if (compiled) return;
+	const int n = reactions.size();
+	rhs_offsets.resize(n+1);
+	stoichiometry.clear();
+	rhs_offsets[0] = 0;
+	for (int i = 0; i < n; ++i) {
+		const ReactionsWithSameRateAndLHS& rs = reactions[i];
+		const int n_r = rs.all_rhs.size();
+		for (int j = 0; j < n_r; ++j) {
+			stoichiometry.add_side(rs.lhs,-1);
+			stoichiometry.add_side(rs.all_rhs[j],1);
+			stoichiometry.end_reaction();
+		}
+		rhs_offsets[i+1] = rhs_offsets[i] + n_r;
+	}
+	compiled = true;
+}
+
+std::size_t ReactionTemplate::hash() const {
+	std::size_t seed = 0;
+	BOOST_FOREACH(const ReactionsWithSameRateAndLHS& r, reactions) {
+		boost::hash_combine(seed,r.rate);
+		boost::hash_combine(seed,r.parameter);
+		hash_side(seed,r.lhs);
+		BOOST_FOREACH(const ReactionSide& rhs, r.all_rhs) {
+			hash_side(seed,rhs);
+		}
+		boost::hash_range(seed,r.rhs_cdf.begin(),r.rhs_cdf.end());
+	}
+	return seed;
 }
 
 
 
+ReactionTemplates::ReactionTemplates():
+		empty(new ReactionTemplate()),
+		next_change(0) {
+	empty->compile();
+	share(empty);
+}
+
+void ReactionTemplates::share(std::shared_ptr<ReactionTemplate>& t) {
+	const std::size_t h = t->hash();
+	typedef std::unordered_multimap<std::size_t,std::shared_ptr<ReactionTemplate> >::iterator iterator;
+	std::pair<iterator,iterator> range = templates.equal_range(h);
+	for (iterator i = range.first; i != range.second; ++i) {
+		if (*(i->second) == *t) {
+			t = i->second;
+			return;
+		}
+	}
+	templates.insert(std::make_pair(h,t));
+}
+
+const ReactionTemplates::Change* ReactionTemplates::find_change(const std::shared_ptr<ReactionTemplate>& from, const ChangeType type,
+		const double rate, const ReactionEquation& eq, const RateParameter* parameter) const {
+	BOOST_FOREACH(const Change& c, changes) {
+		if ((c.from == from) && (c.type == type) && (c.rate == rate) && (c.parameter == parameter) &&
+				(c.eq.lhs == eq.lhs) && (c.eq.rhs == eq.rhs) && ((type == SCALE_REACTION) ||
+				(same_interface_data(c.eq.lhs,eq.lhs) && same_interface_data(c.eq.rhs,eq.rhs)))) {
+			return &c;
+		}
+	}
+	return NULL;
+}
+
+void ReactionTemplates::add_change(const Change& c) {
+	/*
+	 * a few recent changes are enough, as the subvolumes are usually
+	 * changed in order of their index. Moving an interface makes two
+	 * changes to each kind of subvolume along it (edges, corners...)
+	 */
+	const int max_changes = 64;
+	if (int(changes.size()) < max_changes) {
+		changes.push_back(c);
+	} else {
+		changes[next_change] = c;
+		next_change = (next_change+1) % max_changes;
+	}
+}
+
+void ReactionTemplates::prune() {
+	changes.clear();
+	next_change = 0;
+	typedef std::unordered_multimap<std::size_t,std::shared_ptr<ReactionTemplate> >::iterator iterator;
+	for (iterator i = templates.begin(); i != templates.end();) {
+		if ((i->second.use_count() == 1) && (i->second != empty)) {
+			i = templates.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+
+
+ReactionList::ReactionList():
+		reactions_template(new ReactionTemplate()),
+		cell(0),
+		total_propensity(0),
+		inv_total_propensity(0),
+		use_sum_tree(false) {}
+
+ReactionList::ReactionList(const int cell, const std::shared_ptr<ReactionTemplate>& reactions_template):
+		reactions_template(reactions_template),
+		cell(cell),
+		total_propensity(0),
+		inv_total_propensity(0),
+		use_sum_tree(false) {}
+
 void ReactionList::list_reactions() {
+	const int base = get_base_index();
+	const std::vector<ReactionsWithSameRateAndLHS>& reactions = reactions_template->reactions;
 	//for (auto& r : reactions) {
-	for (std::vector<ReactionsWithSameRateAndLHS>::iterator r=reactions.begin();r!=reactions.end();r++) {
-		std::cout <<"With rate = " << r->rate << ":" << std::endl;
+	for (std::vector<ReactionsWithSameRateAndLHS>::const_iterator r=reactions.begin();r!=reactions.end();r++) {
+		std::cout << (r->is_aggregated() ? "With total rate = " : "With rate = ") << r->rate << ":" << std::endl;
 		//for (auto& rhs : r.all_rhs) {
-		for (std::vector<ReactionSide>::iterator rhs=r->all_rhs.begin();rhs!=r->all_rhs.end();rhs++) {
+		for (std::vector<ReactionSide>::const_iterator rhs=r->all_rhs.begin();rhs!=r->all_rhs.end();rhs++) {
 			//for (auto& c : r.lhs) {
-			for (std::vector<ReactionComponent>::iterator c=r->lhs.begin();c!=r->lhs.end();c++) {
+			for (std::vector<ReactionComponent>::const_iterator c=r->lhs.begin();c!=r->lhs.end();c++) {
 				//std::cout << "(" << c.multiplier << "*" << c.species->id << "<" << c.compartment_index << ">) ";
-				std::cout << "(" << c->multiplier << "*" << c->species->id << "<" << c->compartment_index << ">) ";
+				std::cout << "(" << c->multiplier << "*" << c->species->id << "<" << from_template_index(c->compartment_index,base) << ">) ";
 			}
 			std::cout << "-> ";
 			//for (auto& c : rhs) {
-			for (std::vector<ReactionComponent>::iterator c=rhs->begin();c!=rhs->end();c++) {
+			for (std::vector<ReactionComponent>::const_iterator c=rhs->begin();c!=rhs->end();c++) {
 				//std::cout << "(" << c.multiplier << "*" << c.species->id << "<" << c.compartment_index << ">) ";
-				std::cout << "(" << c->multiplier << "*" << c->species->id << "<" << c->compartment_index << ">) ";
+				std::cout << "(" << c->multiplier << "*" << c->species->id << "<" << from_template_index(c->compartment_index,base) << ">) ";
 			}
 			std::cout << std::endl;
 		}
 	}
 }
 
-void ReactionList::add_reaction(const double rate, const ReactionEquation& eq) {
+ReactionTemplate& ReactionList::get_unique_template() {
+	if (reactions_template.use_count() > 1) {
+		reactions_template.reset(new ReactionTemplate(*reactions_template));
+	}
+	return *reactions_template;
+}
 
-	//		if (eq.rhs.size() > 0) {
-	//			if (eq.lhs.size() > 0) {
-	//				std::cout << "adding reaction with lhs = (" << eq.lhs[0].compartment_index << "," << eq.lhs[0].multiplier << ") rhs = (" << eq.rhs[0].compartment_index << "," << eq.rhs[0].multiplier << ")" << std::endl;
-	//			} else {
-	//				std::cout << "adding reaction with lhs = (null) rhs = (" << eq.rhs[0].compartment_index << "," << eq.rhs[0].multiplier << ")" << std::endl;
-	//			}
-	//		} else {
-	//			std::cout << "adding reaction with lhs = (" << eq.lhs[0].compartment_index << "," << eq.lhs[0].multiplier << ") rhs = (null)" << std::endl;
-	//		}
-	bool added = false;
-	//std::cout <<"added unsorted reaction. size of lhs = "<<lhs.size()<<std::endl;
-	ReactionSide sorted_lhs(eq.lhs);
-	std::sort(sorted_lhs.begin(),sorted_lhs.end());
-	//std::cout <<"added sorted reaction. size of lhs = "<<sorted_lhs.size()<<std::endl;
-	//for (auto& r : reactions) {
-	for (std::vector<ReactionsWithSameRateAndLHS>::iterator r=reactions.begin();r!=reactions.end();r++) {
-		//added |= r.add_if_same_lhs(rate, sorted_lhs, eq.rhs);
-		added |= r->add_if_same_lhs(rate, sorted_lhs, eq.rhs);
-		if (added) break;
+ReactionEquation ReactionList::to_template_frame(const ReactionEquation& eq) const {
+	ReactionEquation shifted(eq);
+	BOOST_FOREACH(ReactionComponent& rc, shifted.lhs) {
+		rc.compartment_index = to_template_index(rc.compartment_index,cell);
 	}
-	if (!added) {
-		reactions.push_back(ReactionsWithSameRateAndLHS(rate, sorted_lhs, eq.rhs));
-		propensities.push_back(0);
+	BOOST_FOREACH(ReactionComponent& rc, shifted.rhs) {
+		rc.compartment_index = to_template_index(rc.compartment_index,cell);
 	}
-	my_size++;
+	return shifted;
+}
+
+void ReactionList::resize_propensities() {
+	if (propensities.empty()) return;
+	propensities.assign(reactions_template->reactions.size(),0);
+	if (use_sum_tree) build_sum_tree();
+}
+
+void ReactionList::add_reaction(const double rate, const ReactionEquation& eq, const RateParameter* parameter) {
+	ReactionTemplate& t = get_unique_template();
+	t.add_reaction(rate,to_template_frame(eq),parameter);
+	resize_propensities();
+}
+
+void ReactionList::add_aggregated_reaction(const double rate, const ReactionEquation& eq) {
+	ReactionTemplate& t = get_unique_template();
+	t.add_aggregated_reaction(rate,to_template_frame(eq));
+	resize_propensities();
+}
+
+void ReactionList::add_shared_reaction(const double rate, const ReactionEquation& eq, const bool aggregated, ReactionTemplates& templates,
+		const RateParameter* parameter) {
+	/*
+	 * the same change to the same shared template always gives the same
+	 * result, so it only needs doing once
+	 */
+	const ReactionTemplates::ChangeType type = aggregated ? ReactionTemplates::ADD_AGGREGATED_REACTION : ReactionTemplates::ADD_REACTION;
+	const ReactionEquation relative_eq = to_template_frame(eq);
+	std::shared_ptr<ReactionTemplate> from;
+	if (is_shared()) {
+		const ReactionTemplates::Change* c = templates.find_change(reactions_template,type,rate,relative_eq,parameter);
+		if (c) {
+			reactions_template = c->to;
+			resize_propensities();
+			return;
+		}
+		from = reactions_template;
+	}
+	ReactionTemplate& t = get_unique_template();
+	if (aggregated) {
+		t.add_aggregated_reaction(rate,relative_eq);
+	} else {
+		t.add_reaction(rate,relative_eq,parameter);
+	}
+	resize_propensities();
+	share(templates);
+	if (from) {
+		ReactionTemplates::Change change(from,type,rate,relative_eq,parameter);
+		change.to = reactions_template;
+		templates.add_change(change);
+	}
+}
+
+double ReactionList::scale_shared_reaction(const ReactionEquation& eq, const double factor, ReactionTemplates& templates) {
+	const ReactionEquation relative_eq = to_template_frame(eq);
+	std::shared_ptr<ReactionTemplate> from;
+	if (is_shared()) {
+		const ReactionTemplates::Change* c = templates.find_change(reactions_template,ReactionTemplates::SCALE_REACTION,factor,relative_eq,NULL);
+		if (c) {
+			reactions_template = c->to;
+			resize_propensities();
+			return c->old_rate;
+		}
+		from = reactions_template;
+	}
+	const double old_rate = scale_reaction(eq,factor);
+	share(templates);
+	if (from) {
+		ReactionTemplates::Change change(from,ReactionTemplates::SCALE_REACTION,factor,relative_eq,NULL);
+		change.to = reactions_template;
+		change.old_rate = old_rate;
+		templates.add_change(change);
+	}
+	return old_rate;
+}
+
+void ReactionList::share(ReactionTemplates& templates) {
+	if (is_shared()) return;
+	templates.share(reactions_template);
 }
 
 void ReactionList::clear() {
-	reactions.clear();
+	/*
+	 * a fresh template, so that no lhs index or compiled table of the old
+	 * reactions survives
+	 */
+	reactions_template.reset(new ReactionTemplate());
 	propensities.clear();
-	my_size = 0;
+	sum_tree.clear();
 }
 
 double ReactionList::delete_reaction(const ReactionEquation& eq) {
-	const int n = reactions.size();
-	double ret_rate = 0;
-	bool found = false;
+	return scale_reaction(eq,0);
+}
+
+double ReactionList::scale_reaction(const ReactionEquation& eq, const double factor) {
+	/*
+	 * only copy the template if the reaction is in it
+	 */
+	const ReactionEquation shifted = to_template_frame(eq);
 	int i,j;
-	for (i = 0; i < n; ++i) {
-		if (eq.lhs == reactions[i].lhs) {
-			const int n_r = reactions[i].all_rhs.size();
-			for (j = 0; j < n_r; ++j) {
-				found |= (eq.rhs == reactions[i].all_rhs[j]);
-				if (found) break;
+	if (!reactions_template->find_reaction(shifted,i,j)) return 0;
+	ReactionTemplate& t = get_unique_template();
+	const double rate = factor > 0 ? t.scale_reaction(shifted,factor) : t.erase_reaction(i,j);
+	resize_propensities();
+	return rate;
+}
+
+int ReactionList::pick_random_reaction(const double rand) {
+	ASSERT(reactions_template->compiled,"reaction list has changed since it was compiled");
+	double scaled_rand;
+	const int i = pick_random_index(rand*total_propensity,scaled_rand);
+	return reactions_template->rhs_offsets[i] + reactions_template->reactions[i].pick_random_rhs_index(scaled_rand);
+}
+
+int ReactionList::pick_random_index(const double rand_times_total_propensity, double& scaled_rand) {
+	const int n = propensities.size();
+	if (use_sum_tree) {
+		/*
+		 * descend the Fenwick tree to find the first reaction whose cumulative
+		 * propensity exceeds rand_times_total_propensity
+		 */
+		int step = 1;
+		while (2*step <= n) step *= 2;
+		int i = 0;
+		double remaining = rand_times_total_propensity;
+		for (; step > 0; step /= 2) {
+			if ((i+step <= n) && (sum_tree[i+step-1] <= remaining)) {
+				i += step;
+				remaining -= sum_tree[i-1];
 			}
-			if (found) break;
 		}
-	}
-//	if (!found) {
-//		std::cerr << "ERROR: could not find reaction to erase!!!" << std::endl;
-//		return;
-//	}
-	if (found) {
-		ret_rate = reactions[i].rate;
-		reactions[i].all_rhs.erase(reactions[i].all_rhs.begin() + j);
-		if (reactions[i].all_rhs.size() == 0) {
-			reactions.erase(reactions.begin() + i);
-			propensities.erase(propensities.begin()+i);
+		// guard against round-off in the tree pointing past the last reaction
+		// or at a reaction with zero propensity
+		if (i >= n) {
+			i = n-1;
+			remaining = propensities[i];
+		}
+		while ((propensities[i] == 0) && (i > 0)) {
+			i--;
+			remaining = propensities[i];
 		}
-		my_size--;
+		ASSERT(propensities[i] > 0, "chosen reaction with propensity less than or equal to zero");
+		scaled_rand = remaining/propensities[i];
+		if (scaled_rand >= 1.0) scaled_rand = 0.0;
+		return i;
 	}
-	return ret_rate;
-}
 
-ReactionEquation ReactionList::pick_random_reaction(const double rand) {
 	double last_sum_propensities = 0;
 	double sum_propensities = 0;
-	const int n = reactions.size();
-	const double rand_times_total_propensity = rand*total_propensity;
 	for (int i = 0; i < n; i++) {
 		sum_propensities += propensities[i];
 		if (rand_times_total_propensity < sum_propensities) {
 			ASSERT(propensities[i] > 0, "chosen reaction with propensity less than or equal to zero");
-			const double scaled_rand = (rand_times_total_propensity-last_sum_propensities)/(sum_propensities-last_sum_propensities);
-			return ReactionEquation(reactions[i].lhs,reactions[i].pick_random_rhs(scaled_rand));
+			scaled_rand = (rand_times_total_propensity-last_sum_propensities)/(sum_propensities-last_sum_propensities);
+			return i;
 		}
 		last_sum_propensities = sum_propensities;
 	}
@@ -143,90 +649,326 @@ ReactionEquation ReactionList::pick_random_reaction(const double rand) {
 	//		return ReactionEquation(reactions[n].lhs,reactions[n].pick_random_rhs(rand));
 }
 
+double ReactionList::calculate_propensity(const int i) {
+	const ReactionsWithSameRateAndLHS& rs = reactions_template->reactions[i];
+	const int base = get_base_index();
+	double propensity = 1.0;
+	int beta = 0;
+	//for (auto& rc : rs.lhs) {
+	for (std::vector<ReactionComponent>::const_iterator rc=rs.lhs.begin();rc!=rs.lhs.end();rc++) {
+		int comp_ind = from_template_index(rc->compartment_index,base);
+		if (comp_ind < 0) comp_ind *= -1;
+		int copy_number = rc->species->copy_numbers[comp_ind];
+		beta += rc->multiplier;
+		ASSERT(copy_number >= 0, "copy number is less than zero!!");
+		if (copy_number < rc->multiplier) {
+			return 0.0;
+		}
+		for (int k = 1; k < rc->multiplier; ++k) {
+			copy_number *= copy_number-k;
+		}
+		propensity *= copy_number;
+	}
+	propensity *= rs.get_total_rate();
+	ASSERT(propensity >= 0, "calculated propensity is less than zero!!");
+	return propensity;
+}
+
 double ReactionList::recalculate_propensities() {
 	total_propensity = 0;
 	inv_total_propensity = 0;
-	const int n = reactions.size();
+	const int n = reactions_template->reactions.size();
+	propensities.resize(n);
 	for (int i = 0; i < n; i++) {
-		ReactionsWithSameRateAndLHS& rs = reactions[i];
-		double& propensity = propensities[i];
-		propensity = 1.0;
-		int beta = 0;
-		//for (auto& rc : rs.lhs) {
-		for (std::vector<ReactionComponent>::iterator rc=rs.lhs.begin();rc!=rs.lhs.end();rc++) {
-			int comp_ind = rc->compartment_index;
-			if (comp_ind < 0) comp_ind *= -1;
-			int copy_number = rc->species->copy_numbers[comp_ind];
-			beta += rc->multiplier;
-			ASSERT(copy_number >= 0, "copy number is less than zero!!");
-			if (copy_number < rc->multiplier) {
-				propensity = 0.0;
-				break;
-			}
-			for (int k = 1; k < rc->multiplier; ++k) {
-				copy_number *= copy_number-k;
-			}
-			propensity *= copy_number;
-		}
-		propensity *= rs.size()*rs.rate;
-		ASSERT(propensity >= 0, "calculated propensity is less than zero!!");
-		total_propensity += propensity;
+		propensities[i] = calculate_propensity(i);
+		total_propensity += propensities[i];
 		//			if (reactions[i].lhs[0].compartment_index==0) {
 		//				std::cout << "reaction with neighbour "<<reactions[i].all_rhs[0][0].compartment_index<<" and num particles = " <<
 		//						reactions[i].lhs[0].species->copy_numbers[reactions[i].lhs[0].compartment_index] << " has propensity = "<<propensities[i]<<std::endl;
 		//			}
 	}
+	if (use_sum_tree) build_sum_tree();
 	if (total_propensity != 0) inv_total_propensity = 1.0/total_propensity;
 	return inv_total_propensity;
 }
 
+double ReactionList::update_propensity(const int i) {
+	if (propensities.empty()) return recalculate_propensities();
+	const double new_propensity = calculate_propensity(i);
+	const double delta = new_propensity - propensities[i];
+	if (delta == 0) return inv_total_propensity;
+	propensities[i] = new_propensity;
+	if (use_sum_tree) {
+		const int n = sum_tree.size();
+		for (int j = i+1; j <= n; j += j & (-j)) {
+			sum_tree[j-1] += delta;
+		}
+	}
+	total_propensity += delta;
+
+	/*
+	 * resum when the total has (almost) cancelled, so that an empty list
+	 * gives exactly zero rather than the round-off left over from the deltas
+	 */
+	if (total_propensity <= 1e-9*std::abs(delta)) {
+		return recalculate_propensities();
+	}
+	inv_total_propensity = 1.0/total_propensity;
+	return inv_total_propensity;
+}
+
+ReactionList::ChannelType ReactionList::get_channel_type(const int k) const {
+	const StoichiometryTable& table = get_stoichiometry();
+	const int begin = table.offsets[k];
+	const int end = table.offsets[k+1];
+	for (int e = begin; e < end; ++e) {
+		if (get_compartment_index(e) < 0) return INTERFACE_CHANNEL;
+	}
+	if ((end - begin == 2) && (table.species[begin] == table.species[begin+1]) &&
+			(table.delta[begin] == -1) && (table.delta[begin+1] == 1) &&
+			(table.compartment_index[begin] != table.compartment_index[begin+1])) {
+		return DIFFUSION_CHANNEL;
+	}
+	return REACTION_CHANNEL;
+}
+
+void ReactionList::release_propensities() {
+	std::vector<double>().swap(propensities);
+	std::vector<double>().swap(sum_tree);
+	total_propensity = 0;
+	inv_total_propensity = 0;
+}
+
+void ReactionList::set_sum_tree(const bool use) {
+	use_sum_tree = use;
+	if (use_sum_tree) {
+		build_sum_tree();
+	} else {
+		sum_tree.clear();
+	}
+}
+
+void ReactionList::build_sum_tree() {
+	const int n = propensities.size();
+	sum_tree.assign(propensities.begin(),propensities.end());
+	for (int j = 1; j <= n; ++j) {
+		const int parent = j + (j & (-j));
+		if (parent <= n) sum_tree[parent-1] += sum_tree[j-1];
+	}
+}
+
 
 
 NextSubvolumeMethod::NextSubvolumeMethod(Grid& subvolumes):
 		subvolumes(subvolumes),
+		use_indexed_heap(false),
+		use_sum_tree(false),
+		use_time_rescaling(false),
+		sparse(false),
+		number_of_events(0),
+		dependency_graph_valid(false),
+		dependency_generation(0),
 		uni(generator,boost::uniform_real<>(0,1)),
-		time(0) {
+		time(0),
+		count_activity(false),
+		dirty_cells(subvolumes.size()),
+		watch_changed_cells(false),
+		changed_cells(subvolumes.size()),
+		copy_numbers(new CopyNumberStore(subvolumes.size())) {
 	const int n = subvolumes.size();
 	//std::cout << "created "<<n<<" subvolumes"<<std::endl;
 	heap.clear();
+	flat_heap.reset(n);
 	for (int i = 0; i < n; ++i) {
 		//subvolume_heap_handles.push_back(heap.push(HeapNode(LONGEST_TIME,i)));
 		subvolume_heap_handles.push_back(HeapHandle());
-		subvolume_reactions.push_back(ReactionList());
-		saved_subvolume_reactions.push_back(ReactionList());
+		subvolume_reactions.push_back(ReactionList(i,reaction_templates.get_empty()));
 	}
 }
 
 void NextSubvolumeMethod::reset_execute() {
+	dirty_cells.clear();
 	reset_all_priorities();
+	BOOST_FOREACH(RateParameterUse& use, rate_parameters) {
+		use.version = use.parameter->get_version();
+	}
 }
 
 void NextSubvolumeMethod::add_species_execute(Species &s) {
 	s.set_grid(&subvolumes);
+	s.copy_numbers.attach(copy_numbers);
+	dependency_graph_valid = false;
+	if (count_activity) size_activity_counters();
+}
+
+void NextSubvolumeMethod::set_activity_counters(const bool use) {
+	count_activity = use;
+	if (count_activity) {
+		reset_activity_counters();
+	} else {
+		std::vector<unsigned long>().swap(channel_activity);
+		std::vector<std::vector<unsigned long> >().swap(species_activity);
+	}
+}
+
+void NextSubvolumeMethod::reset_activity_counters() {
+	channel_activity.clear();
+	species_activity.clear();
+	if (count_activity) size_activity_counters();
+}
+
+void NextSubvolumeMethod::size_activity_counters() {
+	const int n = subvolumes.size();
+	channel_activity.resize(n*ReactionList::NUMBER_OF_CHANNEL_TYPES,0);
+	species_activity.resize(copy_numbers->get_number_of_slots());
+	BOOST_FOREACH(std::vector<unsigned long>& counts, species_activity) {
+		counts.resize(n,0);
+	}
+}
+
+std::vector<unsigned long> NextSubvolumeMethod::get_activity(const ReactionList::ChannelType type) const {
+	const int n = subvolumes.size();
+	std::vector<unsigned long> counts(n,0);
+	if (!count_activity) return counts;
+	for (int i = 0; i < n; ++i) {
+		counts[i] = channel_activity[i*ReactionList::NUMBER_OF_CHANNEL_TYPES + type];
+	}
+	return counts;
+}
+
+std::vector<unsigned long> NextSubvolumeMethod::get_activity(const Species& s) const {
+	CHECK(s.copy_numbers.get_store() == copy_numbers,"Species ("<<s.id<<") is not in this NextSubvolumeMethod");
+	if (!count_activity) return std::vector<unsigned long>(subvolumes.size(),0);
+	return species_activity[s.copy_numbers.get_slot()];
+}
+
+vtkSmartPointer<vtkUnstructuredGrid> NextSubvolumeMethod::get_vtk_activity() {
+	StructuredGrid* grid = dynamic_cast<StructuredGrid*>(&subvolumes);
+	CHECK(grid != NULL,"activity can only be written on a StructuredGrid");
+	vtkSmartPointer<vtkUnstructuredGrid> vtk_grid = grid->get_vtk_grid();
+	const char* names[ReactionList::NUMBER_OF_CHANNEL_TYPES] = {"reaction events","diffusion events","interface events"};
+	const int n = subvolumes.size();
+	for (int type = 0; type < ReactionList::NUMBER_OF_CHANNEL_TYPES; ++type) {
+		const std::vector<unsigned long> counts = get_activity(ReactionList::ChannelType(type));
+		vtkSmartPointer<vtkDoubleArray> data = vtkSmartPointer<vtkDoubleArray>::New();
+		data->SetName(names[type]);
+		data->SetNumberOfValues(n);
+		for (int i = 0; i < n; ++i) {
+			data->SetValue(i,counts[i]);
+		}
+		vtk_grid->GetCellData()->AddArray(data);
+	}
+	BOOST_FOREACH(Species* s, get_species()) {
+		const std::vector<unsigned long> counts = get_activity(*s);
+		std::ostringstream name;
+		name << "species " << s->id << " events";
+		vtkSmartPointer<vtkDoubleArray> data = vtkSmartPointer<vtkDoubleArray>::New();
+		data->SetName(name.str().c_str());
+		data->SetNumberOfValues(n);
+		for (int i = 0; i < n; ++i) {
+			data->SetValue(i,counts[i]);
+		}
+		vtk_grid->GetCellData()->AddArray(data);
+	}
+	return vtk_grid;
 }
 
 
 void  NextSubvolumeMethod::add_reaction(const double rate, ReactionEquation eq) {
+	add_reactions(std::vector<double>(1,rate),std::vector<ReactionEquation>(1,eq));
+}
+
+void NextSubvolumeMethod::add_reactions(const std::vector<double>& rates, const std::vector<ReactionEquation>& equations) {
+	install_reactions(rates,equations,NULL);
+}
+
+void NextSubvolumeMethod::add_reaction(RateParameter& rate, ReactionEquation eq) {
+	use_rate_parameter(rate);
+	install_reactions(std::vector<double>(1,1.0),std::vector<ReactionEquation>(1,eq),&rate);
+}
+
+void NextSubvolumeMethod::add_reaction_to_compartments(RateParameter& rate, ReactionEquation eq, const std::vector<int>& indicies) {
+	use_rate_parameter(rate);
+	BOOST_FOREACH(int i, indicies) {
+		install_reaction(1.0,eq,i,&rate);
+		reset_priority(i);
+	}
+}
+
+void NextSubvolumeMethod::use_rate_parameter(RateParameter& rate) {
+	BOOST_FOREACH(const RateParameterUse& use, rate_parameters) {
+		if (use.parameter == &rate) return;
+	}
+	rate_parameters.push_back(RateParameterUse(&rate));
+}
+
+void NextSubvolumeMethod::install_reactions(const std::vector<double>& rates, const std::vector<ReactionEquation>& equations,
+		const RateParameter* parameter) {
+	ASSERT(rates.size() == equations.size(), "rates and equations vectors must be the same length");
+	dependency_graph_valid = false;
 	const int n = subvolumes.size();
+	const int nr = rates.size();
+
+	/*
+	 * the result only depends on the template and the subvolume volume. The
+	 * first subvolume with each template and volume builds it, in subvolume
+	 * order, and the others are switched to it in parallel. The original
+	 * templates are kept alive, so their addresses can't be reused
+	 */
+	struct Change {
+		std::shared_ptr<ReactionTemplate> from;
+		std::shared_ptr<ReactionTemplate> to;
+	};
+	typedef std::pair<const ReactionTemplate*,double> Key;
+	std::map<Key,int> first_change;
+	std::vector<Change> changes;
+	std::vector<int> change_of(n,-1);
+	for (int i = 0; i < n; ++i) {
+		ReactionList& list = subvolume_reactions[i];
+		const std::shared_ptr<ReactionTemplate> from = list.get_template();
+		const Key key(from.get(),subvolumes.get_cell_volume(i));
+		std::map<Key,int>::const_iterator first = first_change.find(key);
+		if (first != first_change.end()) {
+			change_of[i] = first->second;
+			continue;
+		}
+		first_change[key] = changes.size();
+		changes.push_back(Change());
+		changes.back().from = from;
+		for (int j = 0; j < nr; ++j) {
+			install_reaction(rates[j],equations[j],i,parameter);
+		}
+		changes.back().to = list.get_template();
+	}
+
+	#pragma omp parallel for schedule(static)
 	for (int i = 0; i < n; ++i) {
-		add_reaction_to_compartment(rate,eq,i);
+		if (change_of[i] < 0) continue;
+		subvolume_reactions[i].set_template(changes[change_of[i]].to);
 	}
+
+	reset_all_priorities();
 }
 
 void  NextSubvolumeMethod::add_reaction_to_compartment(const double rate, ReactionEquation eq, const int i) {
+	install_reaction(rate,eq,i);
+	reset_priority(i);
+}
+
+void  NextSubvolumeMethod::install_reaction(const double rate, ReactionEquation eq, const int i, const RateParameter* parameter) {
 	eq.lhs.set_compartment_index(i);
 	eq.rhs.set_compartment_index(i);
+	dependency_graph_valid = false;
 	const int beta = eq.lhs.get_num_reactants();
 	if (beta == 0) {
-		subvolume_reactions[i].add_reaction(rate*subvolumes.get_cell_volume(i),eq);
+		subvolume_reactions[i].add_shared_reaction(rate*subvolumes.get_cell_volume(i),eq,false,reaction_templates,parameter);
 
 	} else if (beta == 1) {
-		subvolume_reactions[i].add_reaction(rate,eq);
+		subvolume_reactions[i].add_shared_reaction(rate,eq,false,reaction_templates,parameter);
 
 	} else {
-		subvolume_reactions[i].add_reaction(rate*pow(subvolumes.get_cell_volume(i),1-eq.lhs.get_num_reactants()),eq);
+		subvolume_reactions[i].add_shared_reaction(rate*pow(subvolumes.get_cell_volume(i),1-eq.lhs.get_num_reactants()),eq,false,reaction_templates,parameter);
 	}
-	reset_priority(i);
 }
 
 
@@ -252,27 +994,143 @@ void  NextSubvolumeMethod::add_reaction_to_compartment(const double rate, Reacti
 //}
 
 void NextSubvolumeMethod::add_diffusion(Species &s) {
-	this->add_species(s);
+	add_diffusion(std::vector<Species*>(1,&s));
+}
 
+void NextSubvolumeMethod::add_diffusion(const std::vector<Species*>& species) {
+	BOOST_FOREACH(Species* s, species) {
+		this->add_species(*s);
+	}
+	dependency_graph_valid = false;
 	const int n = subvolumes.size();
+
+	/*
+	 * the result only depends on the template and the neighbour offsets and
+	 * laplace coefficients of the subvolume. These are hashed in parallel,
+	 * the first subvolume with each hash builds the result, in subvolume
+	 * order, and the others are checked against it and switched to it in
+	 * parallel. Subvolumes that don't match (hash collisions) build their
+	 * own
+	 */
+	std::vector<std::size_t> hashes(n);
+	#pragma omp parallel for schedule(static)
 	for (int i = 0; i < n; ++i) {
-		const std::vector<int>& neighbrs = subvolumes.get_neighbour_indicies(i);
-		const int nn = neighbrs.size();
-		for (int j = 0; j < nn; ++j) {
-			const double rate = s.D[0]*subvolumes.get_laplace_coefficient(i,neighbrs[j]);
-			ReactionSide lhs;
-			lhs.push_back(ReactionComponent(1.0,s,i));
-			ReactionSide rhs;
-			rhs.push_back(ReactionComponent(1.0,s,neighbrs[j]));
-			subvolume_reactions[i].add_reaction(rate,ReactionEquation(lhs,rhs));
+		hashes[i] = diffusion_pattern_hash(i);
+	}
+
+	struct Change {
+		std::shared_ptr<ReactionTemplate> from;
+		std::vector<std::pair<int,double> > pattern;
+		std::shared_ptr<ReactionTemplate> to;
+	};
+	std::unordered_map<std::size_t,int> first_change;
+	std::vector<Change> changes;
+	std::vector<int> change_of(n,-1);
+	for (int i = 0; i < n; ++i) {
+		ReactionList& list = subvolume_reactions[i];
+		const std::shared_ptr<ReactionTemplate> from = list.get_template();
+		std::unordered_map<std::size_t,int>::const_iterator first = first_change.find(hashes[i]);
+		if (first != first_change.end()) {
+			change_of[i] = first->second;
+			continue;
+		}
+		first_change[hashes[i]] = changes.size();
+		changes.push_back(Change());
+		changes.back().from = from;
+		get_diffusion_pattern(i,changes.back().pattern);
+		install_diffusion(species,i);
+		changes.back().to = list.get_template();
+	}
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; ++i) {
+		if (change_of[i] < 0) continue;
+		const Change& change = changes[change_of[i]];
+		if (change.to && (subvolume_reactions[i].get_template() == change.from) &&
+				has_diffusion_pattern(i,change.pattern)) {
+			subvolume_reactions[i].set_template(change.to);
+			change_of[i] = -1;
 		}
 	}
+	for (int i = 0; i < n; ++i) {
+		if (change_of[i] >= 0) install_diffusion(species,i);
+	}
 
 	reset_all_priorities();
 }
 
+std::size_t NextSubvolumeMethod::diffusion_pattern_hash(const int i) const {
+	std::size_t hash = boost::hash_value(subvolume_reactions[i].get_template().get());
+	const std::vector<int>& neighbrs = subvolumes.get_neighbour_indicies(i);
+	const int nn = neighbrs.size();
+	for (int j = 0; j < nn; ++j) {
+		boost::hash_combine(hash,neighbrs[j]-i);
+		boost::hash_combine(hash,subvolumes.get_laplace_coefficient(i,neighbrs[j]));
+	}
+	return hash;
+}
+
+void NextSubvolumeMethod::get_diffusion_pattern(const int i, std::vector<std::pair<int,double> >& pattern) const {
+	const std::vector<int>& neighbrs = subvolumes.get_neighbour_indicies(i);
+	const int nn = neighbrs.size();
+	pattern.resize(nn);
+	for (int j = 0; j < nn; ++j) {
+		pattern[j].first = neighbrs[j]-i;
+		pattern[j].second = subvolumes.get_laplace_coefficient(i,neighbrs[j]);
+	}
+}
+
+bool NextSubvolumeMethod::has_diffusion_pattern(const int i, const std::vector<std::pair<int,double> >& pattern) const {
+	const std::vector<int>& neighbrs = subvolumes.get_neighbour_indicies(i);
+	const int nn = neighbrs.size();
+	if (int(pattern.size()) != nn) return false;
+	for (int j = 0; j < nn; ++j) {
+		if ((neighbrs[j]-i != pattern[j].first) ||
+				(subvolumes.get_laplace_coefficient(i,neighbrs[j]) != pattern[j].second)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void NextSubvolumeMethod::install_diffusion(const std::vector<Species*>& species, const int i) {
+	const std::vector<int>& neighbrs = subvolumes.get_neighbour_indicies(i);
+	const int nn = neighbrs.size();
+
+	/*
+	 * neighbours with the same laplace coefficient used to share a channel
+	 * (in order of first appearance), and were drawn channel by channel.
+	 * Adding them to the aggregated channel in that order keeps the draw
+	 * order, so that a seed gives the same trajectory as before
+	 */
+	neighbour_order.clear();
+	for (int j = 0; j < nn; ++j) {
+		const double coefficient = subvolumes.get_laplace_coefficient(i,neighbrs[j]);
+		bool first = true;
+		for (int k = 0; k < j; ++k) {
+			if (subvolumes.get_laplace_coefficient(i,neighbrs[k]) == coefficient) first = false;
+		}
+		if (!first) continue;
+		for (int k = j; k < nn; ++k) {
+			if (subvolumes.get_laplace_coefficient(i,neighbrs[k]) == coefficient) neighbour_order.push_back(k);
+		}
+	}
+
+	BOOST_FOREACH(Species* s, species) {
+		BOOST_FOREACH(int j, neighbour_order) {
+			const double rate = s->D[0]*subvolumes.get_laplace_coefficient(i,neighbrs[j]);
+			ReactionSide lhs;
+			lhs.push_back(ReactionComponent(1.0,*s,i));
+			ReactionSide rhs;
+			rhs.push_back(ReactionComponent(1.0,*s,neighbrs[j]));
+			subvolume_reactions[i].add_shared_reaction(rate,ReactionEquation(lhs,rhs),true,reaction_templates);
+		}
+	}
+}
+
 void NextSubvolumeMethod::add_diffusion_between(Species &s, const double rate, std::vector<int>& from, std::vector<int>& to) {
 	ASSERT(from.size() == to.size(), "From and To vectors must be the same length");
+	dependency_graph_valid = false;
 	const int n = from.size();
 	for (int i = 0; i < n; ++i) {
 		ReactionSide lhs;
@@ -286,73 +1144,481 @@ void NextSubvolumeMethod::add_diffusion_between(Species &s, const double rate, s
 }
 
 void NextSubvolumeMethod::reset_all_priorities() {
+	if (sparse && dependency_graph_valid && copy_numbers->get_paged()) {
+		reset_occupied_priorities();
+		return;
+	}
+	/*
+	 * the propensities of each subvolume are independent, so recalculate
+	 * them in parallel. The event times are drawn in subvolume order, so
+	 * that they do not depend on the number of threads, and the queue is
+	 * rebuilt in one go
+	 */
 	const int n = subvolumes.size();
+	#pragma omp parallel for schedule(static)
 	for (int i = 0; i < n; ++i) {
+		reset_propensities(i);
+	}
+	queue_nodes.clear();
+	for (int i = 0; i < n; ++i) {
+		const double total_propensity = subvolume_reactions[i].get_propensity();
+		if (total_propensity != 0) {
+			const double inv_total_propensity = 1.0/total_propensity;
+			double rand = uni();
+			while (rand==0.0) rand = uni();
+			queue_nodes.push_back(HeapNode(time - inv_total_propensity*log(rand),i));
+		}
+	}
+	if (use_indexed_heap) {
+		flat_heap.swap(queue_nodes);
+	} else {
+		heap.clear();
+		BOOST_FOREACH(const HeapNode& node, queue_nodes) {
+			subvolume_heap_handles[node.subvolume_index] = heap.push(node);
+		}
+	}
+}
+
+void NextSubvolumeMethod::reset_occupied_priorities() {
+	/*
+	 * a subvolume can only have propensities if it has molecules, which
+	 * means its page of copy numbers is allocated, or if it reacts without
+	 * them. Those are visited in subvolume order, as in
+	 * reset_all_priorities, and the pages left empty are freed
+	 */
+	const int n = subvolumes.size();
+	const int np = copy_numbers->get_number_of_pages();
+	occupied_subvolumes.clear();
+	for (int p = 0; p < np; ++p) {
+		if (!copy_numbers->is_page_allocated(p)) continue;
+		const int end = std::min(n,(p+1)*CopyNumberStore::PAGE_SIZE);
+		for (int i = p*CopyNumberStore::PAGE_SIZE; i < end; ++i) {
+			occupied_subvolumes.push_back(i);
+		}
+	}
+	const int middle = occupied_subvolumes.size();
+	occupied_subvolumes.insert(occupied_subvolumes.end(),reacting_without_molecules.begin(),reacting_without_molecules.end());
+	std::inplace_merge(occupied_subvolumes.begin(),occupied_subvolumes.begin()+middle,occupied_subvolumes.end());
+	occupied_subvolumes.erase(std::unique(occupied_subvolumes.begin(),occupied_subvolumes.end()),occupied_subvolumes.end());
+
+	const int no = occupied_subvolumes.size();
+	#pragma omp parallel for schedule(static)
+	for (int k = 0; k < no; ++k) {
+		reset_propensities(occupied_subvolumes[k]);
+	}
+	queue_nodes.clear();
+	for (int k = 0; k < no; ++k) {
+		const int i = occupied_subvolumes[k];
+		const double total_propensity = subvolume_reactions[i].get_propensity();
+		if (total_propensity != 0) {
+			const double inv_total_propensity = 1.0/total_propensity;
+			double rand = uni();
+			while (rand==0.0) rand = uni();
+			queue_nodes.push_back(HeapNode(time - inv_total_propensity*log(rand),i));
+		}
+	}
+	if (use_indexed_heap) {
+		flat_heap.swap(queue_nodes);
+	} else {
+		heap.clear();
+		BOOST_FOREACH(const HeapNode& node, queue_nodes) {
+			subvolume_heap_handles[node.subvolume_index] = heap.push(node);
+		}
+	}
+	copy_numbers->release_empty_pages();
+}
+
+void NextSubvolumeMethod::reset_priorities(std::vector<int>& indicies) {
+	/*
+	 * each subvolume once, however many of its reactions changed
+	 */
+	std::sort(indicies.begin(),indicies.end());
+	indicies.erase(std::unique(indicies.begin(),indicies.end()),indicies.end());
+	BOOST_FOREACH(int i, indicies) {
 		reset_priority(i);
 	}
 }
 
-void NextSubvolumeMethod::reset_priority(const int i) {
-	const bool in_queue = subvolume_reactions[i].get_propensity()!=0;
+void NextSubvolumeMethod::set_indexed_heap(const bool use) {
+	if (use == use_indexed_heap) return;
+
+	/*
+	 * move all queued subvolumes over to the new queue
+	 */
+	const int n = subvolumes.size();
+	std::vector<double> times(n,0);
+	for (int i = 0; i < n; ++i) {
+		if (subvolume_reactions[i].get_propensity() != 0) {
+			times[i] = queue_get_time(i);
+		}
+	}
+	heap.clear();
+	flat_heap.reset(n);
+	use_indexed_heap = use;
+	if (use) {
+		std::vector<HeapHandle>().swap(subvolume_heap_handles);
+	} else {
+		subvolume_heap_handles.assign(n,HeapHandle());
+	}
+	for (int i = 0; i < n; ++i) {
+		if (subvolume_reactions[i].get_propensity() != 0) {
+			queue_push(i,times[i]);
+		}
+	}
+}
 
-	const double inv_total_propensity = subvolume_reactions[i].recalculate_propensities();
-	if (inv_total_propensity != 0) {
+void NextSubvolumeMethod::set_propensity_sum_tree(const bool use) {
+	use_sum_tree = use;
+	const int n = subvolumes.size();
+	for (int i = 0; i < n; ++i) {
+		subvolume_reactions[i].set_sum_tree(use);
+	}
+}
+
+void NextSubvolumeMethod::build_dependency_graph() {
+	const int n = subvolumes.size();
+	const std::vector<Species*>& species = get_species();
+	const int ns = species.size();
+
+	species_slots.clear();
+	for (int is = 0; is < ns; ++is) {
+		if (species[is]->id >= int(species_slots.size())) species_slots.resize(species[is]->id+1,-1);
+		species_slots[species[is]->id] = is;
+	}
+
+	find_rate_parameter_cells();
+	if (sparse) {
+		build_sparse_dependency_graph();
+		reaction_templates.prune();
+		dependency_graph_valid = true;
+		return;
+	}
+	remote_dependencies.clear();
+	std::vector<int>().swap(reacting_without_molecules);
+
+	/*
+	 * count the dependents of each (species, compartment), then fill them in
+	 */
+	dependency_offsets.assign(ns*n+1,0);
+	for (std::unordered_map<int,ReactionList>::iterator suspended = suspended_reactions.begin(); suspended != suspended_reactions.end(); ++suspended) {
+		suspended->second.share(reaction_templates);
+		suspended->second.compile();
+	}
+	for (int i = 0; i < n; ++i) {
+		subvolume_reactions[i].share(reaction_templates);
+		subvolume_reactions[i].compile();
+		const std::vector<ReactionsWithSameRateAndLHS>& reactions = get_dependency_reactions(i).get_reactions();
+		const int base = subvolume_reactions[i].get_base_index();
+		const int nr = reactions.size();
+		for (int r = 0; r < nr; ++r) {
+			BOOST_FOREACH(const ReactionComponent& rc, reactions[r].lhs) {
+				const int k = get_copy_number_key(rc.species,from_template_index(rc.compartment_index,base));
+				if (k >= 0) dependency_offsets[k+1]++;
+			}
+		}
+	}
+	for (int k = 0; k < ns*n; ++k) {
+		dependency_offsets[k+1] += dependency_offsets[k];
+	}
+	dependencies.assign(dependency_offsets[ns*n],DependentReaction(0,0));
+	std::vector<int> next(dependency_offsets.begin(),dependency_offsets.end()-1);
+	for (int i = 0; i < n; ++i) {
+		const std::vector<ReactionsWithSameRateAndLHS>& reactions = get_dependency_reactions(i).get_reactions();
+		const int base = subvolume_reactions[i].get_base_index();
+		const bool suspended = is_suspended(i);
+		const int nr = reactions.size();
+		for (int r = 0; r < nr; ++r) {
+			BOOST_FOREACH(const ReactionComponent& rc, reactions[r].lhs) {
+				const int k = get_copy_number_key(rc.species,from_template_index(rc.compartment_index,base));
+				if (k >= 0) dependencies[next[k]++] = DependentReaction(i,suspended ? -(r+1) : r);
+			}
+		}
+	}
+	reaction_templates.prune();
+	dependency_graph_valid = true;
+}
+
+const ReactionList& NextSubvolumeMethod::get_dependency_reactions(const int i) const {
+	if (suspended_reactions.empty()) return subvolume_reactions[i];
+	std::unordered_map<int,ReactionList>::const_iterator suspended = suspended_reactions.find(i);
+	return suspended == suspended_reactions.end() ? subvolume_reactions[i] : suspended->second;
+}
+
+void NextSubvolumeMethod::set_dependencies_enabled(const int i, const bool enabled) {
+	const ReactionList& reactions = get_dependency_reactions(i);
+	const std::vector<ReactionsWithSameRateAndLHS>& channels = reactions.get_reactions();
+	const int base = reactions.get_base_index();
+	const int nr = channels.size();
+	for (int r = 0; r < nr; ++r) {
+		const int from = enabled ? -(r+1) : r;
+		BOOST_FOREACH(const ReactionComponent& rc, channels[r].lhs) {
+			const int k = get_copy_number_key(rc.species,from_template_index(rc.compartment_index,base));
+			if (k < 0) continue;
+			const int end = dependency_offsets[k+1];
+			for (int d = dependency_offsets[k]; d < end; ++d) {
+				DependentReaction& dep = dependencies[d];
+				if ((dep.subvolume_index == i) && (dep.reaction_index == from)) dep.reaction_index = -(from+1);
+			}
+		}
+	}
+}
+
+void NextSubvolumeMethod::build_sparse_dependency_graph() {
+	const int n = subvolumes.size();
+	const int ns = get_species().size();
+	std::vector<int>().swap(dependency_offsets);
+	std::vector<DependentReaction>().swap(dependencies);
+	remote_dependencies.clear();
+	reacting_without_molecules.clear();
+	dependency_generation++;
+	for (int i = 0; i < n; ++i) {
+		ReactionList& reactions = subvolume_reactions[i];
+		reactions.share(reaction_templates);
+		reactions.compile();
+		reactions.index_lhs(species_slots,ns,dependency_generation);
+		if (reactions.has_unindexed_lhs() || reactions.has_remote_lhs()) reacting_without_molecules.push_back(i);
+		if (!reactions.has_remote_lhs()) continue;
+		const std::vector<ReactionsWithSameRateAndLHS>& channels = reactions.get_reactions();
+		const int base = reactions.get_base_index();
+		const int nr = channels.size();
+		for (int r = 0; r < nr; ++r) {
+			BOOST_FOREACH(const ReactionComponent& rc, channels[r].lhs) {
+				const int c = from_template_index(rc.compartment_index,base);
+				if ((c == i) || (c == -i)) continue;
+				const int k = get_copy_number_key(rc.species,c);
+				if (k >= 0) remote_dependencies[k].push_back(DependentReaction(i,r));
+			}
+		}
+	}
+}
+
+int NextSubvolumeMethod::get_copy_number_key(const Species* s, const int compartment_index) const {
+	const int id = s->id;
+	if ((id >= int(species_slots.size())) || (species_slots[id] < 0)) return -1;
+	const int c = compartment_index < 0 ? -compartment_index : compartment_index;
+	return species_slots[id]*subvolumes.size() + c;
+}
+
+void NextSubvolumeMethod::mark_dirty(const int i, std::vector<std::pair<int,double> >& dirty) {
+	const int n = dirty.size();
+	for (int k = 0; k < n; ++k) {
+		if (dirty[k].first == i) return;
+	}
+	dirty.push_back(std::make_pair(i,subvolume_reactions[i].get_propensity()));
+}
+
+void NextSubvolumeMethod::changed_copy_number(const int key, std::vector<std::pair<int,double> >& dirty) {
+	if (key < 0) return;
+	if (sparse) {
+		const int n = subvolumes.size();
+		const int c = key%n;
+		const int slot = key/n;
+		ReactionList& reactions = subvolume_reactions[c];
+		const std::vector<int>& lhs_reactions = reactions.get_lhs_reactions();
+		const int end = reactions.get_lhs_offsets()[slot+1];
+		for (int d = reactions.get_lhs_offsets()[slot]; d < end; ++d) {
+			mark_dirty(c,dirty);
+			reactions.update_propensity(lhs_reactions[d]);
+		}
+		if (remote_dependencies.empty()) return;
+		std::unordered_map<int,std::vector<DependentReaction> >::const_iterator remote = remote_dependencies.find(key);
+		if (remote == remote_dependencies.end()) return;
+		BOOST_FOREACH(const DependentReaction& dep, remote->second) {
+			mark_dirty(dep.subvolume_index,dirty);
+			subvolume_reactions[dep.subvolume_index].update_propensity(dep.reaction_index);
+		}
+		return;
+	}
+	const int end = dependency_offsets[key+1];
+	for (int d = dependency_offsets[key]; d < end; ++d) {
+		const DependentReaction& dep = dependencies[d];
+		if (dep.reaction_index < 0) continue;
+		mark_dirty(dep.subvolume_index,dirty);
+		subvolume_reactions[dep.subvolume_index].update_propensity(dep.reaction_index);
+	}
+}
+
+void NextSubvolumeMethod::mark_dependent_subvolumes(const int key, DirtyCells& dirty) const {
+	if (key < 0) return;
+	if (sparse) {
+		dirty.mark(key%subvolumes.size());
+		if (remote_dependencies.empty()) return;
+		std::unordered_map<int,std::vector<DependentReaction> >::const_iterator remote = remote_dependencies.find(key);
+		if (remote == remote_dependencies.end()) return;
+		BOOST_FOREACH(const DependentReaction& dep, remote->second) {
+			dirty.mark(dep.subvolume_index);
+		}
+		return;
+	}
+	const int end = dependency_offsets[key+1];
+	for (int d = dependency_offsets[key]; d < end; ++d) {
+		dirty.mark(dependencies[d].subvolume_index);
+	}
+}
+
+int NextSubvolumeMethod::pick_ghost_molecule(Species& s, const int ghost_index) {
+	Molecules& mols = s.mols;
+	if (mols.is_cell_indexed(ghost_index)) {
+		/*
+		 * every operator that moves molecules must update their index
+		 * entries, a stale or missing entry would skew the choice
+		 */
+		ASSERT(mols.is_cell_index_consistent(ghost_index), "index of ghost cell "<<ghost_index<<" is out of date");
+		ASSERT(mols.get_number_in_cell(ghost_index) > 0, "no molecule found in ghost cell "<<ghost_index);
+		return mols.get_random_molecule_in_cell(ghost_index,uni());
+	}
+
+	// Gather a list of molecule indices residing in the
+	// ghost cell
+	const int p_n = mols.size();
+	ghost_indices.clear();
+	for (int p_i = 0; p_i < p_n; ++p_i) {
+		const Vect3d r = mols.r[p_i];
+		if (subvolumes.get_cell_index(r)==ghost_index)
+			ghost_indices.push_back(p_i);
+	}
+	ASSERT(ghost_indices.size() > 0, "no molecule found in ghost cell "<<ghost_index);
+	return ghost_indices[(int)(uni()*ghost_indices.size())];
+}
+
+void NextSubvolumeMethod::schedule(const int i, const bool in_queue) {
+	const double total_propensity = subvolume_reactions[i].get_propensity();
+	if (total_propensity != 0) {
+		const double inv_total_propensity = 1.0/total_propensity;
 		double rand = uni();
 		while (rand==0.0) rand = uni();
 		const double time_at_next_reaction = time - inv_total_propensity*log(rand);
 		if (in_queue) {
-			(*subvolume_heap_handles[i]).time_at_next_reaction = time_at_next_reaction;
-			heap.update(subvolume_heap_handles[i]);
+			queue_update(i,time_at_next_reaction);
 		} else {
-			subvolume_heap_handles[i] = heap.push(HeapNode(time_at_next_reaction,i));
+			queue_push(i,time_at_next_reaction);
 		}
 	} else {
 		if (in_queue) {
-			heap.erase(subvolume_heap_handles[i]);
+			queue_erase(i);
 		}
 	}
+}
 
+void NextSubvolumeMethod::reschedule(const int i, const double old_propensity) {
+	const double total_propensity = subvolume_reactions[i].get_propensity();
+	if (use_time_rescaling && (old_propensity != 0) && (total_propensity != 0)) {
+		/*
+		 * the time left is exponential with rate old_propensity, so scaled
+		 * by old/new propensity it is exponential with the new rate
+		 */
+		const double old_time = queue_get_time(i);
+		queue_update(i,time + (old_propensity/total_propensity)*(old_time - time));
+	} else {
+		schedule(i,old_propensity != 0);
+	}
+}
+
+void NextSubvolumeMethod::reset_priority(const int i) {
+	const bool in_queue = subvolume_reactions[i].get_propensity()!=0;
+	reset_propensities(i);
+	schedule(i,in_queue);
+}
+
+void NextSubvolumeMethod::reset_propensities(const int i) {
+	ReactionList& reactions = subvolume_reactions[i];
+	if (!sparse) {
+		reactions.recalculate_propensities();
+		return;
+	}
+	if (dependency_graph_valid && !has_reactants(i)) {
+		reactions.release_propensities();
+		return;
+	}
+	reactions.recalculate_propensities();
+	if (reactions.get_propensity() == 0) reactions.release_propensities();
+}
+
+bool NextSubvolumeMethod::has_reactants(const int i) const {
+	const ReactionList& reactions = subvolume_reactions[i];
+	if (reactions.has_unindexed_lhs() || reactions.has_remote_lhs()) return true;
+	const std::vector<int>& offsets = reactions.get_lhs_offsets();
+	const std::vector<Species*>& species = get_species();
+	const int ns = int(offsets.size()) - 1;
+	for (int s = 0; s < ns; ++s) {
+		if ((offsets[s+1] != offsets[s]) && (copy_numbers->get(i,species[s]->copy_numbers.get_slot()) != 0)) return true;
+	}
+	return false;
 }
 
 void NextSubvolumeMethod::recalc_priority(const int i) {
 	const double old_propensity = subvolume_reactions[i].get_propensity();
-	const bool in_queue = old_propensity!=0;
-	const double inv_total_propensity = subvolume_reactions[i].recalculate_propensities();
-	//HeapNode& h = *(subvolume_heap_handles[i]);
-	if (inv_total_propensity != 0) {
-		//const double time_to_next_reaction = -inv_total_propensity*log(uni());
-		if (in_queue) {
-			const double old_time = (*subvolume_heap_handles[i]).time_at_next_reaction;
-			//const double new_time = time + old_propensity*inv_total_propensity*(old_time - time);
-			double rand = uni();
-			while (rand==0.0) rand = uni();
-			const double new_time = time - inv_total_propensity*log(rand);
-			(*subvolume_heap_handles[i]).time_at_next_reaction = new_time;
-			heap.update(subvolume_heap_handles[i]);
-		} else {
-			double rand = uni();
-			while (rand==0.0) rand = uni();
-			const double new_time = time - inv_total_propensity*log(rand);
-			subvolume_heap_handles[i] = heap.push(HeapNode(new_time,i));
+	subvolume_reactions[i].recalculate_propensities();
+	reschedule(i,old_propensity);
+}
+
+void NextSubvolumeMethod::refresh_rate_parameters() {
+	BOOST_FOREACH(RateParameterUse& use, rate_parameters) {
+		if (use.version == use.parameter->get_version()) continue;
+		use.version = use.parameter->get_version();
+		BOOST_FOREACH(int i, use.cells) {
+			dirty_cells.mark(i);
 		}
+	}
+}
 
-	} else {
-		if (in_queue) {
-			heap.erase(subvolume_heap_handles[i]);
+void NextSubvolumeMethod::flush_dirty_cells() {
+	if (dirty_cells.empty()) return;
+	const std::vector<int>& cells = dirty_cells.get_sorted();
+	const int n = cells.size();
+	dirty_cell_propensities.resize(n);
+	for (int k = 0; k < n; ++k) {
+		dirty_cell_propensities[k] = subvolume_reactions[cells[k]].get_propensity();
+	}
+	/*
+	 * the propensities of different subvolumes are independent, the event
+	 * times are drawn in subvolume order so runs don't depend on threads
+	 */
+	#pragma omp parallel for schedule(static) if (n > 1024)
+	for (int k = 0; k < n; ++k) {
+		reset_propensities(cells[k]);
+	}
+	for (int k = 0; k < n; ++k) {
+		reschedule(cells[k],dirty_cell_propensities[k]);
+		if (watch_changed_cells) changed_cells.mark(cells[k]);
+	}
+	dirty_cells.clear();
+}
+
+void NextSubvolumeMethod::find_rate_parameter_cells() {
+	if (rate_parameters.empty()) return;
+	const int n = subvolumes.size();
+	const int np = rate_parameters.size();
+	BOOST_FOREACH(RateParameterUse& use, rate_parameters) {
+		use.cells.clear();
+	}
+	for (int i = 0; i < n; ++i) {
+		BOOST_FOREACH(const ReactionsWithSameRateAndLHS& rs, subvolume_reactions[i].get_reactions()) {
+			if (rs.parameter == NULL) continue;
+			for (int p = 0; p < np; ++p) {
+				std::vector<int>& cells = rate_parameters[p].cells;
+				if ((rate_parameters[p].parameter == rs.parameter) && (cells.empty() || (cells.back() != i))) {
+					cells.push_back(i);
+				}
+			}
 		}
 	}
 }
 
 void NextSubvolumeMethod::integrate(const double dt) {
+	if (!dependency_graph_valid) build_dependency_graph();
 	time = get_time();
+	refresh_rate_parameters();
+	flush_dirty_cells();
 	const double final_time = time + dt;
 	while (get_next_event_time() <= final_time) {
-		const int sv_i = heap.top().subvolume_index;
-		time = heap.top().time_at_next_reaction;
+		const int sv_i = queue_top().subvolume_index;
+		time = queue_top().time_at_next_reaction;
+		number_of_events++;
 		//std::cout << "dealing with subvolume with time = " << time << " and index = " << sv_i << std::endl;
 		const double rand = uni();
-		ReactionEquation r = subvolume_reactions[sv_i].pick_random_reaction(rand);
-		react(r);
+		const int k = subvolume_reactions[sv_i].pick_random_reaction(rand);
+		react(sv_i,k);
 	}
 	time = final_time;
 
@@ -371,13 +1637,19 @@ void NextSubvolumeMethod::set_interface_reactions(
 		std::vector<int>& to_indicies,
 		const double dt,
 		const bool corrected) {
+	synchronise();
 	const unsigned int n = from_indicies.size();
 	ASSERT(n==to_indicies.size(),"from and to indicies vectors have different size");
+	dependency_graph_valid = false;
 	/*
-	 * update diffusion reaction rates for neighbouring cells
+	 * update diffusion reaction rates for neighbouring cells. Subvolumes
+	 * along a flat interface have the same templates before and after, so
+	 * the templates are changed once and the rest of the subvolumes find
+	 * the change in the cache
 	 */
 	const std::vector<Species*> diffusing_species = get_species();
 	const int ns = diffusing_species.size();
+	std::vector<int> changed;
 	for (int is = 0; is < ns; ++is) {
 		Species& s = *diffusing_species[is];
 		for (unsigned int ii = 0; ii < n; ++ii) {
@@ -388,7 +1660,7 @@ void NextSubvolumeMethod::set_interface_reactions(
 			ReactionSide rhs;
 			rhs.push_back(ReactionComponent(1.0,s,j));
 			rhs[0].tmp = std::sqrt(2.0*s.D[0]*dt);
-			double rate = subvolume_reactions[i].delete_reaction(ReactionEquation(lhs,rhs));
+			double rate = subvolume_reactions[i].scale_shared_reaction(ReactionEquation(lhs,rhs),0,reaction_templates);
 			if (rate != 0) {
 			  const Vect3d centre = subvolumes.get_cell_centre(i);
 			  const Rectangle face = subvolumes.get_face_between(i,j);
@@ -401,13 +1673,64 @@ void NextSubvolumeMethod::set_interface_reactions(
 				//std::cout << "new interface rate = rate * 2*"<<subvolumes.get_distance_between(i,j)<<" div sqrt(pi*d*dt)"<<std::endl;
 				//rate *= 0.5;
 				rhs[0].compartment_index = -j;
-				subvolume_reactions[i].add_reaction(rate,ReactionEquation(lhs,rhs));
-				reset_priority(i);
+				subvolume_reactions[i].add_shared_reaction(rate,ReactionEquation(lhs,rhs),false,reaction_templates);
+				changed.push_back(i);
 			}
 //			std::cout << "reactions for i,j = "<<i<<","<<j<<std::endl;
 //			subvolume_reactions[i].list_reactions();
 		}
 	}
+	reset_priorities(changed);
+}
+
+void NextSubvolumeMethod::suspend_subvolumes(const std::vector<int>& indicies) {
+	synchronise();
+	BOOST_FOREACH(int i, indicies) {
+		if (is_suspended(i)) continue;
+		/*
+		 * the copy keeps the template, the dependency graph keeps its
+		 * entries but skips them until the subvolume resumes
+		 */
+		ReactionList& reactions = subvolume_reactions[i];
+		if (dependency_graph_valid) {
+			if (!sparse) {
+				set_dependencies_enabled(i,false);
+			} else if (reactions.has_remote_lhs()) {
+				dependency_graph_valid = false;
+			}
+		}
+		suspended_reactions.insert(std::make_pair(i,reactions));
+		reactions.set_template(reaction_templates.get_empty());
+		if (sparse) reactions.index_lhs(species_slots,get_species().size(),dependency_generation);
+		reset_priority(i);
+	}
+}
+
+void NextSubvolumeMethod::resume_subvolumes(const std::vector<int>& indicies) {
+	synchronise();
+	BOOST_FOREACH(int i, indicies) {
+		std::unordered_map<int,ReactionList>::iterator suspended = suspended_reactions.find(i);
+		if (suspended == suspended_reactions.end()) continue;
+		ReactionList& reactions = subvolume_reactions[i];
+		reactions = suspended->second;
+		suspended_reactions.erase(suspended);
+		if (dependency_graph_valid) {
+			reactions.share(reaction_templates);
+			reactions.compile();
+			if (!sparse) {
+				set_dependencies_enabled(i,true);
+			} else {
+				reactions.index_lhs(species_slots,get_species().size(),dependency_generation);
+				if (reactions.has_remote_lhs()) {
+					dependency_graph_valid = false;
+				} else if (reactions.has_unindexed_lhs()) {
+					std::vector<int>::iterator pos = std::lower_bound(reacting_without_molecules.begin(),reacting_without_molecules.end(),i);
+					if ((pos == reacting_without_molecules.end()) || (*pos != i)) reacting_without_molecules.insert(pos,i);
+				}
+			}
+		}
+		reset_priority(i);
+	}
 }
 
 void NextSubvolumeMethod::fill_uniform(Species& s, const Vect3d low, const Vect3d high, const unsigned int N) {
@@ -415,31 +1738,33 @@ void NextSubvolumeMethod::fill_uniform(Species& s, const Vect3d low, const Vect3
 	LOG(2,"Adding "<<N<<" molecules of Species ("<<s.id<<") within the rectangle defined by "<<low<<" and "<<high);
 
 	boost::variate_generator<base_generator_type&, boost::uniform_real<> > uni(generator, boost::uniform_real<>(0,1));
-	std::set<int> dirty_indices;
 	const Vect3d dist = high-low;
 	for(int i=0;i<N;i++) {
 		const Vect3d pos = Vect3d(uni()*dist[0],uni()*dist[1],uni()*dist[2])+low;
 		if (subvolumes.is_in(pos)) {
 		  int comp_ind = subvolumes.get_cell_index(pos);
 		  s.copy_numbers[comp_ind]++;
-		  dirty_indices.insert(comp_ind);
+		  dirty_cells.mark(comp_ind);
 		}
 	}
-	for(auto ind : dirty_indices)
-	  recalc_priority(ind);
+	flush_dirty_cells();
 }
 
 void NextSubvolumeMethod::unset_interface_reactions(
 		std::vector<int>& from_indicies,
 		std::vector<int>& to_indicies) {
+	synchronise();
 	/*
-	 * update diffusion reaction rates for neighbouring cells
+	 * update diffusion reaction rates for neighbouring cells, through the
+	 * template cache as in set_interface_reactions
 	 */
 	const unsigned int n = from_indicies.size();
 	ASSERT(n==to_indicies.size(),"from and to indicies vectors have different size");
+	dependency_graph_valid = false;
 
 	const std::vector<Species*> diffusing_species = get_species();
 	const unsigned int ns = diffusing_species.size();
+	std::vector<int> changed;
 	for (unsigned int is = 0; is < ns; ++is) {
 		Species& s = *diffusing_species[is];
 		for (unsigned int ii = 0; ii < n; ++ii) {
@@ -449,104 +1774,103 @@ void NextSubvolumeMethod::unset_interface_reactions(
 			lhs.push_back(ReactionComponent(1.0,s,i));
 			ReactionSide rhs;
 			rhs.push_back(ReactionComponent(1.0,s,-j));
-			double rate = subvolume_reactions[i].delete_reaction(ReactionEquation(lhs,rhs));
+			double rate = subvolume_reactions[i].scale_shared_reaction(ReactionEquation(lhs,rhs),0,reaction_templates);
 			if (rate != 0) {
 				rate = s.D[0]*subvolumes.get_laplace_coefficient(i,j);
 				if (rate != 0) {
 					rhs[0].compartment_index = j;
-					subvolume_reactions[i].add_reaction(rate,ReactionEquation(lhs,rhs));
+					subvolume_reactions[i].add_shared_reaction(rate,ReactionEquation(lhs,rhs),true,reaction_templates);
 				}
-				reset_priority(i);
+				changed.push_back(i);
 			}
 		}
 	}
+	reset_priorities(changed);
 }
 
 
-void NextSubvolumeMethod::react(ReactionEquation& eq) {
-        int dirty_compartment_index = -1;
-	//for (auto& rc : eq.lhs) {
-	for (std::vector<ReactionComponent>::iterator rc=eq.lhs.begin();rc!=eq.lhs.end();rc++) {
-		const int i = rc->compartment_index;
-
-		// If compartment_index is less than zero, assume that
-		// it is a ghost cell
-		if (i<0) {
-		  Species &s = *(rc->species);
-		  const int p_n = s.mols.size();
-
-		  // Gather a list of molecule indices residing in the
-		  // ghost cell
-		  std::vector<int> ghost_indices;
-		  for (int p_i = 0; p_i < p_n; ++p_i) {
-		    const Vect3d r = s.mols.r[p_i];
-		    //if ((subvolumes.is_in(r)) &&
-		    //(subvolumes.get_cell_index(r)==-i))
-		    if (subvolumes.get_cell_index(r)==-i)
-		      ghost_indices.push_back(p_i);
-		  }
+void NextSubvolumeMethod::react(const int sv_i, const int k) {
+	/*
+	 * the subvolume that fired always needs a new event time, all others
+	 * only if the propensities that depend on a changed copy number do
+	 */
+	if (count_activity) count_event(sv_i,k);
+	dirty_subvolumes.clear();
+	mark_dirty(sv_i);
+	fire(subvolume_reactions[sv_i],k);
 
-		  // Pick one of them and delete it. Also decrease the
-		  // copy number of the ghost cell accordingly
-		  int d_i = (int)(uni()*ghost_indices.size());
-		  s.mols.delete_molecule(ghost_indices[d_i]);
-		  s.copy_numbers[-i]--;
-		  dirty_compartment_index = -i;
-		} else {
-		  rc->species->copy_numbers[i] -= rc->multiplier;
-		  dirty_compartment_index = i;
+	/*
+	 * propensities are exponential clocks, so a subvolume whose total
+	 * propensity did not change keeps its event time
+	 */
+	const int n = dirty_subvolumes.size();
+	for (int d = 0; d < n; ++d) {
+		const int i = dirty_subvolumes[d].first;
+		const double old_propensity = dirty_subvolumes[d].second;
+		if (i == sv_i) {
+			schedule(i,old_propensity != 0);
+		} else if (subvolume_reactions[i].get_propensity() != old_propensity) {
+			reschedule(i,old_propensity);
 		}
-		//rc.species->copy_numbers[rc.compartment_index] -= rc.multiplier;
-//		if ((rc.compartment_index==0)||(rc.compartment_index==560)) {
-//			print = true;
-//			std::cout<<" compartment "<<rc.compartment_index<<" changed to have "<<rc.species->copy_numbers[rc.compartment_index]<<" molecules"<<std::endl;
-//		}
-		ASSERT(dirty_compartment_index>=0,"dirty_compartment_index is smaller than zero!!");
-		reset_priority(dirty_compartment_index);
-	}
-	dirty_compartment_index = -1;
-	//for (auto& rc : eq.rhs) {
-	for (std::vector<ReactionComponent>::iterator rc=eq.rhs.begin();rc!=eq.rhs.end();rc++) {
-		if (rc->compartment_index < 0) {
-//			const double step_length = rc.tmp;
-//			const double dt = pow(step_length,2)/(2.0*rc.species->D);
-//			const double kappa = 0.86*step_length/dt;
-//			const double h = subvolumes.get_distance_between(eq.lhs[0].compartment_index,-rc.compartment_index);
-//			const double P1 = kappa*h/rc.species->D;
-//			std::cout << "absorbing with P1 = "<<P1<<std::endl;
-//			if (uni() < P1) {
-		  Rectangle r = subvolumes.get_face_between(eq.lhs[0].compartment_index,-rc->compartment_index);
-		  Vect3d oldr,newn;
-		  r.get_random_point_and_normal_triangle(oldr, newn);
-		  double dist_from_intersect;
-		  
-		  // If rc->tmp is negative, assume that we want to jump into a ghost cell
-		  if (rc->tmp<0) {
-		    // -rc->tmp is the compartment size
-		    dist_from_intersect = -rc->tmp*uni();
-		    dirty_compartment_index = -rc->compartment_index;
-		    rc->species->copy_numbers[dirty_compartment_index]++;
-		  } else { // If rc->tmp is positive, assume that we use a TRM interface
-		    // rc->tmp is the step length.
-		    const double P = uni();
-		    const double P2 = pow(P,2);
-		    const double step_length = rc->tmp;
-		    dist_from_intersect = step_length*(0.729614*P - 0.70252*P2)/(1.0 - 1.47494*P + 0.484371*P2);
-		  }
-		  const Vect3d newr = oldr + newn*dist_from_intersect;
-		  rc->species->mols.add_molecule(newr,oldr);
-//			} else {
-//				rc.species->copy_numbers[rc.compartment_index] += rc.multiplier;
-//			}
+	}
+}
+
+void NextSubvolumeMethod::fire(const ReactionList& reactions, const int k) {
+	const StoichiometryTable& table = reactions.get_stoichiometry();
+	const int begin = table.offsets[k];
+	const int end = table.offsets[k+1];
+	for (int e = begin; e < end; ++e) {
+		const int i = reactions.get_compartment_index(e);
+		if (i < 0) {
+			fire_across_interface(reactions,begin,e,dirty_subvolumes);
 		} else {
-			rc->species->copy_numbers[rc->compartment_index] += rc->multiplier;
-			dirty_compartment_index = rc->compartment_index;
+			Species& s = *table.species[e];
+			s.copy_numbers[i] += table.delta[e];
+			changed_copy_number(s,i);
+			if (watch_changed_cells) changed_cells.mark(i);
 		}
-//		if ((rc.compartment_index==0)||(rc.compartment_index==560)) {
-//			std::cout<<" compartment "<<rc.compartment_index<<" changed to have "<<rc.species->copy_numbers[rc.compartment_index]<<" molecules"<<std::endl;
-//		}
 	}
-	if (dirty_compartment_index >= 0) recalc_priority(dirty_compartment_index);
+}
+
+void NextSubvolumeMethod::fire_across_interface(const ReactionList& reactions, const int begin, const int e,
+		std::vector<std::pair<int,double> >& dirty) {
+	const StoichiometryTable& table = reactions.get_stoichiometry();
+	const int i = reactions.get_compartment_index(e);
+	Species& s = *table.species[e];
+	if (table.delta[e] < 0) {
+		// Pick one of the molecules residing in the ghost cell
+		// and delete it. Also decrease the copy number of the
+		// ghost cell accordingly
+		s.mols.delete_molecule(pick_ghost_molecule(s,-i));
+		s.copy_numbers[-i]--;
+		changed_copy_number(get_copy_number_key(&s,-i),dirty);
+		if (watch_changed_cells) changed_cells.mark(-i);
+		return;
+	}
+
+	// the first reactant is the compartment the molecule leaves from
+	Rectangle r = subvolumes.get_face_between(reactions.get_compartment_index(begin),-i);
+	Vect3d oldr,newn;
+	r.get_random_point_and_normal_triangle(oldr, newn);
+	double dist_from_intersect;
+
+	// If tmp is negative, assume that we want to jump into a ghost cell
+	if (table.tmp[e]<0) {
+		// -tmp is the compartment size
+		dist_from_intersect = -table.tmp[e]*uni();
+		const int ghost_index = -i;
+		s.copy_numbers[ghost_index]++;
+		changed_copy_number(get_copy_number_key(&s,ghost_index),dirty);
+		if (watch_changed_cells) changed_cells.mark(ghost_index);
+	} else { // If tmp is positive, assume that we use a TRM interface
+		// tmp is the step length.
+		const double P = uni();
+		const double P2 = pow(P,2);
+		const double step_length = table.tmp[e];
+		dist_from_intersect = step_length*(0.729614*P - 0.70252*P2)/(1.0 - 1.47494*P + 0.484371*P2);
+	}
+	const Vect3d newr = oldr + newn*dist_from_intersect;
+	s.mols.add_molecule(newr,oldr);
 }
 
 
@@ -554,6 +1878,7 @@ void NextSubvolumeMethod::print(std::ostream& out) const {
 	out << "\tNext Subvolume Method:"<<std::endl;
 	out << "\t\tGrid:"<<std::endl;
 	out << "\t\t\tlow = "<<get_grid().get_low() << " high = "<<get_grid().get_high()<<std::endl;
+	out << "\t\tShared reaction templates: "<<reaction_templates.size()<<std::endl;
 	out << "\t\tDiffusing Species:"<<std::endl;
 	for (unsigned int i = 0; i < get_species().size(); ++i) {
 		Species *s = get_species()[i];
@@ -28,12 +28,18 @@
 #include <boost/heap/pairing_heap.hpp>
 #include <vector>
 #include <set>
+#include <memory>
+#include <unordered_map>
+#include <boost/foreach.hpp>
 #include "MyRandom.h"
 #include "Species.h"
 #include "Operator.h"
 #include <set>
 #include "StructuredGrid.h"
 #include "ReactionEquation.h"
+#include "IndexedHeap.h"
+#include "RateParameter.h"
+#include "DirtyCells.h"
 
 namespace Tyche {
 
@@ -55,65 +61,396 @@ struct HeapNode {
 };
 typedef boost::heap::pairing_heap<HeapNode> PriorityHeap;
 typedef boost::heap::pairing_heap<HeapNode>::handle_type HeapHandle;
+typedef IndexedHeap<HeapNode,4> FlatPriorityHeap;
+
+/*
+ * compartment indices in a reaction template are offsets from the
+ * subvolume using it. An index across an interface (-j, see
+ * set_interface_reactions) is stored as the offset to j less
+ * INTERFACE_OFFSET, so that it survives the translation
+ */
+const int INTERFACE_OFFSET = 1<<30;
+inline int to_template_index(const int c, const int cell) {
+	return c < 0 ? -c - cell - INTERFACE_OFFSET : c - cell;
+}
+inline int from_template_index(const int c, const int cell) {
+	return c < -INTERFACE_OFFSET/2 ? -(c + INTERFACE_OFFSET + cell) : c + cell;
+}
+
+/*
+ * flat stoichiometry of a list of reactions, one entry per reactant or
+ * product. The entries of reaction k are offsets[k] to offsets[k+1]-1,
+ * reactants first (delta < 0) then products (delta > 0). tmp holds the
+ * interface data of ReactionComponent for negative compartment indices
+ */
+struct StoichiometryTable {
+	void clear() {
+		offsets.assign(1,0);
+		species.clear();
+		compartment_index.clear();
+		delta.clear();
+		tmp.clear();
+	}
+	void add_side(const ReactionSide& side, const int sign) {
+		BOOST_FOREACH(const ReactionComponent& rc, side) {
+			species.push_back(rc.species);
+			compartment_index.push_back(rc.compartment_index);
+			delta.push_back(sign*rc.multiplier);
+			tmp.push_back(rc.tmp);
+		}
+	}
+	void end_reaction() {
+		offsets.push_back(species.size());
+	}
+
+	std::vector<int> offsets;
+	std::vector<Species*> species;
+	std::vector<int> compartment_index;
+	std::vector<int> delta;
+	std::vector<double> tmp;
+};
 
 struct ReactionsWithSameRateAndLHS {
-	ReactionsWithSameRateAndLHS(const double rate, const ReactionSide& lhs, const ReactionSide& rhs):
+	ReactionsWithSameRateAndLHS(const double rate, const ReactionSide& lhs, const ReactionSide& rhs, const RateParameter* parameter = NULL):
 		lhs(lhs),
-		rate(rate) {
+		rate(rate),
+		parameter(parameter) {
 		all_rhs.push_back(rhs);
 		//std::cout <<"added new reaction. size of lhs = "<<lhs.size()<<std::endl;
 	}
 //	~ReactionsWithSameRateAndLHS() {
 //		all_rhs.clear();
 //	}
-	bool add_if_same_lhs(const double rate_to_add, const ReactionSide& lhs_to_add, const ReactionSide& rhs_to_add);
+	ReactionsWithSameRateAndLHS(const ReactionSide& lhs):
+		lhs(lhs),
+		rate(0),
+		parameter(NULL) {}
+	bool add_if_same_lhs(const double rate_to_add, const ReactionSide& lhs_to_add, const ReactionSide& rhs_to_add,
+			const RateParameter* parameter_to_add = NULL);
+	void add_aggregated_rhs(const double rate_to_add, const ReactionSide& rhs_to_add);
+	double erase_rhs(const int j);
+	int pick_random_rhs_index(const double rand) const;
 	ReactionSide& pick_random_rhs(const double rand);
 
 	int size() {
 		return all_rhs.size();
 	}
+	bool is_aggregated() const {
+		return !rhs_cdf.empty();
+	}
+	double get_total_rate() const {
+		const double total_rate = is_aggregated() ? rate : all_rhs.size()*rate;
+		return parameter ? total_rate*parameter->get_value() : total_rate;
+	}
+	double get_rhs_fraction(const int j) const {
+		if (!is_aggregated()) return 1.0/all_rhs.size();
+		return (rhs_cdf[j] - (j > 0 ? rhs_cdf[j-1] : 0))/rate;
+	}
+	bool operator==(const ReactionsWithSameRateAndLHS& arg) const;
 
 	ReactionSide lhs;
 	double rate;
 	std::vector<ReactionSide> all_rhs;
+
+	/*
+	 * if set, the rate is multiplied by the current value of the parameter
+	 */
+	const RateParameter* parameter;
+
+	/*
+	 * an aggregated channel (e.g. diffusion of a species out of a cell) has
+	 * a different rate for each rhs. rate is then their sum, and rhs_cdf[j]
+	 * the sum of the rates of rhs 0 to j
+	 */
+	std::vector<double> rhs_cdf;
 };
 
+/*
+ * open addressing hash table (linear probing) from a key to the reactions
+ * with that key. All slots are in one vector, kept at most half full, so
+ * that copying a template copies its index in one go
+ */
+class ReactionIndex {
+public:
+	ReactionIndex():size(0) {}
+	void clear() {
+		slots.clear();
+		size = 0;
+	}
+	void insert(const std::size_t key, const int reaction);
+	void erase(const std::size_t key, const int reaction);
+	void replace(const std::size_t key, const int old_reaction, const int new_reaction);
 
+	/*
+	 * the next reaction with key after slot (-1 to start), or -1 if there
+	 * are no more
+	 */
+	int next(const std::size_t key, int& slot) const {
+		if (slots.empty()) return -1;
+		const int mask = slots.size()-1;
+		slot = slot < 0 ? int(key & mask) : ((slot+1) & mask);
+		while (slots[slot].reaction >= 0) {
+			if (slots[slot].key == key) return slots[slot].reaction;
+			slot = (slot+1) & mask;
+		}
+		return -1;
+	}
+private:
+	struct Slot {
+		Slot():key(0),reaction(-1) {}
+		std::size_t key;
+		int reaction;
+	};
+	void rehash(const int capacity);
+	std::vector<Slot> slots;
+	int size;
+};
 
+/*
+ * the reactions of a subvolume, together with their stoichiometry table.
+ * Most subvolumes have the same reactions up to a translation, so a
+ * template, whose compartment indices are offsets from the subvolume
+ * using it (see to_template_index), is shared between all of them (see
+ * ReactionTemplates). This includes the subvolumes along a flat interface.
+ */
+struct ReactionTemplate {
+	ReactionTemplate():my_size(0),compiled(false),indexed(false),lhs_generation(-1),remote_lhs(false),unindexed_lhs(false) {}
+	void add_reaction(const double rate, const ReactionEquation& eq, const RateParameter* parameter = NULL);
+	void add_aggregated_reaction(const double rate, const ReactionEquation& eq);
+	double delete_reaction(const ReactionEquation& eq);
+	double erase_reaction(const int i, const int j);
+	double scale_reaction(const ReactionEquation& eq, const double factor);
+	bool find_reaction(const ReactionEquation& eq, int& i, int& j) const;
+	void compile();
+	std::size_t hash() const;
+	bool operator==(const ReactionTemplate& arg) const {
+		return reactions == arg.reactions;
+	}
+
+	int my_size;
+	std::vector<ReactionsWithSameRateAndLHS> reactions;
+
+	/*
+	 * reactions compiled into a flat table by compile(), so that firing a
+	 * reaction needs no copies. The rhs j of reaction i is entry
+	 * rhs_offsets[i]+j of the table
+	 */
+	bool compiled;
+	std::vector<int> rhs_offsets;
+	StoichiometryTable stoichiometry;
+
+	/*
+	 * reactions hashed by their lhs, built on first use so that finding,
+	 * adding or deleting a reaction only looks at the few reactions with
+	 * the same lhs
+	 */
+	void build_index() const;
+	void erase_channel(const int i);
+	int find_channel(const ReactionSide& sorted_lhs, const double rate, const bool aggregated, const RateParameter* parameter) const;
+	static std::size_t lhs_key(const ReactionSide& sorted_lhs);
+	mutable bool indexed;
+	mutable ReactionIndex index;
+
+	/*
+	 * the reactions whose lhs has the species in slot s in the subvolume
+	 * using the template are lhs_reactions[lhs_offsets[s]] to
+	 * lhs_reactions[lhs_offsets[s+1]-1]. remote_lhs is set if a lhs is in
+	 * another subvolume, unindexed_lhs if a reaction has no lhs or one of
+	 * a species without a slot. Built for the sparse NSM, lhs_generation
+	 * says which build of its dependencies they belong to
+	 */
+	void index_lhs(const std::vector<int>& species_slots, const int number_of_slots, const int base, const int cell);
+	int lhs_generation;
+	bool remote_lhs;
+	bool unindexed_lhs;
+	std::vector<int> lhs_offsets;
+	std::vector<int> lhs_reactions;
+};
+
+/*
+ * pool of the templates in use, looked up by hash. Templates in the pool
+ * are never modified, a subvolume changing its reactions works on a copy
+ * that is shared again once the change is done. Recent changes are cached,
+ * so that applying the same change to many subvolumes with the same
+ * template only builds the result once
+ */
+class ReactionTemplates {
+public:
+	/*
+	 * adding a reaction with a rate, or multiplying the rate of one by a
+	 * factor (given as the rate), which gives old_rate
+	 */
+	enum ChangeType {ADD_REACTION, ADD_AGGREGATED_REACTION, SCALE_REACTION};
+	struct Change {
+		Change(const std::shared_ptr<ReactionTemplate>& from, const ChangeType type, const double rate,
+				const ReactionEquation& eq, const RateParameter* parameter):
+					from(from),type(type),rate(rate),eq(eq),parameter(parameter),old_rate(0) {}
+		std::shared_ptr<ReactionTemplate> from;
+		ChangeType type;
+		double rate;
+		ReactionEquation eq;
+		const RateParameter* parameter;
+		std::shared_ptr<ReactionTemplate> to;
+		double old_rate;
+	};
+
+	ReactionTemplates();
+	const std::shared_ptr<ReactionTemplate>& get_empty() const {
+		return empty;
+	}
+	void share(std::shared_ptr<ReactionTemplate>& t);
+	const Change* find_change(const std::shared_ptr<ReactionTemplate>& from, const ChangeType type,
+			const double rate, const ReactionEquation& eq, const RateParameter* parameter) const;
+	void add_change(const Change& c);
+	void prune();
+	int size() const {
+		return templates.size();
+	}
+private:
+	std::shared_ptr<ReactionTemplate> empty;
+	std::unordered_multimap<std::size_t,std::shared_ptr<ReactionTemplate> > templates;
+	std::vector<Change> changes;
+	int next_change;
+};
+
+/*
+ * reactions of one subvolume: a (possibly shared) template plus the
+ * propensities of its reactions in this subvolume. Compartment indices
+ * read from the template must be translated with from_template_index and
+ * get_base_index(), or read through get_compartment_index()
+ */
 class ReactionList {
 public:
-	ReactionList():
-		total_propensity(0),my_size(0),
-		inv_total_propensity(0) {}
-//	~ReactionList() {
-//		reactions.clear();
-//		propensities.clear();
-//	}
+	/*
+	 * what firing a channel does: a reaction, a jump to a neighbouring
+	 * subvolume, or a jump across an interface (to a ghost cell or off
+	 * the lattice)
+	 */
+	enum ChannelType {REACTION_CHANNEL, DIFFUSION_CHANNEL, INTERFACE_CHANNEL, NUMBER_OF_CHANNEL_TYPES};
+
+	ReactionList();
+	ReactionList(const int cell, const std::shared_ptr<ReactionTemplate>& reactions_template);
 	void operator=(const ReactionList& arg) {
-		reactions = arg.reactions;
+		reactions_template = arg.reactions_template;
+		cell = arg.cell;
 		propensities.assign(arg.propensities.size(),0);
 		total_propensity = 0;
 		inv_total_propensity = 0;
-		my_size = arg.my_size;
+		use_sum_tree = arg.use_sum_tree;
+		sum_tree.assign(propensities.size(),0);
 	}
 	void list_reactions();
-	void add_reaction(const double rate, const ReactionEquation& eq);
+	void add_reaction(const double rate, const ReactionEquation& eq, const RateParameter* parameter = NULL);
+	void add_aggregated_reaction(const double rate, const ReactionEquation& eq);
 	double delete_reaction(const ReactionEquation& eq);
+	/*
+	 * multiply the rate of a reaction by factor, deleting it if factor <= 0.
+	 * Returns its old rate, or zero if the list does not have the reaction
+	 */
+	double scale_reaction(const ReactionEquation& eq, const double factor);
 	void clear();
-	ReactionEquation pick_random_reaction(const double rand);
+
+	/*
+	 * add or rescale a reaction, leaving the list with a shared template
+	 */
+	void add_shared_reaction(const double rate, const ReactionEquation& eq, const bool aggregated, ReactionTemplates& templates,
+			const RateParameter* parameter = NULL);
+	double scale_shared_reaction(const ReactionEquation& eq, const double factor, ReactionTemplates& templates);
+	void share(ReactionTemplates& templates);
+	bool is_shared() const {
+		return reactions_template.use_count() > 1;
+	}
+	const std::shared_ptr<ReactionTemplate>& get_template() const {
+		return reactions_template;
+	}
+	/*
+	 * switch to a template built for another subvolume
+	 */
+	void set_template(const std::shared_ptr<ReactionTemplate>& t) {
+		reactions_template = t;
+		resize_propensities();
+	}
+
+	int pick_random_reaction(const double rand);
+	void compile() {
+		reactions_template->compile();
+	}
 	double recalculate_propensities();
-	double get_propensity() {
+	double update_propensity(const int i);
+	/*
+	 * free the propensities of a list that cannot react, they are
+	 * recalculated when one of its copy numbers next changes
+	 */
+	void release_propensities();
+	void set_sum_tree(const bool use);
+	double get_propensity() const {
 		return total_propensity;
 	}
 	int size() {
-		return my_size;
+		return reactions_template->my_size;
+	}
+	const std::vector<ReactionsWithSameRateAndLHS>& get_reactions() const {
+		return reactions_template->reactions;
+	}
+	double get_reaction_propensity(const int i) const {
+		return propensities[i];
+	}
+	int get_rhs_offset(const int i) const {
+		ASSERT(reactions_template->compiled,"reaction list has changed since it was compiled");
+		return reactions_template->rhs_offsets[i];
+	}
+	const StoichiometryTable& get_stoichiometry() const {
+		ASSERT(reactions_template->compiled,"reaction list has changed since it was compiled");
+		return reactions_template->stoichiometry;
+	}
+	/*
+	 * type of entry k of the stoichiometry table
+	 */
+	ChannelType get_channel_type(const int k) const;
+	int get_base_index() const {
+		return cell;
+	}
+	int get_compartment_index(const int e) const {
+		return from_template_index(reactions_template->stoichiometry.compartment_index[e],cell);
+	}
+	void index_lhs(const std::vector<int>& species_slots, const int number_of_slots, const int generation) {
+		if (reactions_template->lhs_generation == generation) return;
+		reactions_template->index_lhs(species_slots,number_of_slots,get_base_index(),cell);
+		reactions_template->lhs_generation = generation;
+	}
+	bool has_remote_lhs() const {
+		return reactions_template->remote_lhs;
+	}
+	bool has_unindexed_lhs() const {
+		return reactions_template->unindexed_lhs;
+	}
+	const std::vector<int>& get_lhs_offsets() const {
+		return reactions_template->lhs_offsets;
+	}
+	const std::vector<int>& get_lhs_reactions() const {
+		return reactions_template->lhs_reactions;
 	}
 private:
+	double calculate_propensity(const int i);
+	int pick_random_index(const double rand_times_total_propensity, double& scaled_rand);
+	void build_sum_tree();
+	ReactionTemplate& get_unique_template();
+	ReactionEquation to_template_frame(const ReactionEquation& eq) const;
+	void resize_propensities();
+
+	std::shared_ptr<ReactionTemplate> reactions_template;
+	int cell;
 	double total_propensity;
-	double my_size;
-	std::vector<ReactionsWithSameRateAndLHS> reactions;
 	std::vector<double> propensities;
 	double inv_total_propensity;
+
+	/*
+	 * Fenwick tree over propensities, used for O(log k) selection and update
+	 * when use_sum_tree is set. sum_tree[i] holds the sum of propensities
+	 * (i+1-lowbit(i+1),i]
+	 */
+	bool use_sum_tree;
+	std::vector<double> sum_tree;
 };
 
 //template<typename T>
@@ -170,11 +507,15 @@ public:
 	    std::vector<int> gv(ghost_cell_indices.begin(), ghost_cell_indices.end());
 	    clear_reactions(gv);
 	  }
+	  dependency_graph_valid = false;
 	  const int fn = from_indices.size();
 	  const std::vector<Species*> diffusing_species = get_species();
 	  const int ns = diffusing_species.size();
+	  const std::vector<int> gv(ghost_cell_indices.begin(), ghost_cell_indices.end());
 	  for (int is = 0; is < ns; ++is) {
 	    Species& s = *diffusing_species[is];
+	    // index the molecules in the ghost cells, so react() can pick one in O(1)
+	    s.mols.add_cell_index(&subvolumes, gv);
 	    for (unsigned int ii = 0; ii < fn; ++ii) {
 	      const int i = from_indices[ii];
 	      const int j = to_indices[ii];
@@ -236,12 +577,31 @@ public:
 	void set_interface_reactions(std::vector<int>& from_indicies, std::vector<int>& to_indicies, const double dt, const bool corrected);
 	void unset_interface_reactions(std::vector<int>& from_indicies, std::vector<int>& to_indicies);
 	void add_diffusion(Species &s);
+	/*
+	 * add the diffusion of several species in one pass over the grid.
+	 * Subvolumes with the same template and the same neighbour pattern
+	 * (offsets and laplace coefficients) get the same result, which is only
+	 * built once, so the cost per subvolume is that of looking it up. The
+	 * event times are drawn once for all the species, so the random number
+	 * sequence differs from adding them one at a time
+	 */
+	void add_diffusion(const std::vector<Species*>& species);
 	void add_reaction(const double rate, ReactionEquation eq);
+	/*
+	 * add several reactions to every subvolume in one pass over the grid,
+	 * building the result once for each template and subvolume volume
+	 */
+	void add_reactions(const std::vector<double>& rates, const std::vector<ReactionEquation>& equations);
+	/*
+	 * add a reaction whose rate is the current value of a RateParameter,
+	 * see RateParameter
+	 */
+	void add_reaction(RateParameter& rate, ReactionEquation eq);
 	void add_reaction_on(const double rate, ReactionEquation eq, const Geometry& geometry) {
 		std::vector<int> indicies;
 		subvolumes.get_slice(geometry,indicies);
 		for (unsigned int i = 0; i < indicies.size(); ++i) {
-			add_reaction_to_compartment(rate,eq,i);
+			add_reaction_to_compartment(rate,eq,indicies[i]);
 		}
 	}
 
@@ -249,9 +609,19 @@ public:
 		std::vector<int> indicies;
 		subvolumes.get_region(geometry,indicies);
 		for (unsigned int i = 0; i < indicies.size(); ++i) {
-			add_reaction_to_compartment(rate,eq,i);
+			add_reaction_to_compartment(rate,eq,indicies[i]);
 		}
 	}
+	void add_reaction_on(RateParameter& rate, ReactionEquation eq, const Geometry& geometry) {
+		std::vector<int> indicies;
+		subvolumes.get_slice(geometry,indicies);
+		add_reaction_to_compartments(rate,eq,indicies);
+	}
+	void add_reaction_in(RateParameter& rate, ReactionEquation eq, const Geometry& geometry) {
+		std::vector<int> indicies;
+		subvolumes.get_region(geometry,indicies);
+		add_reaction_to_compartments(rate,eq,indicies);
+	}
 
 	void add_diffusion_between(Species &s, const double rate, Geometry& geometry_from, Geometry& geometry_to) {
 		std::vector<int> from,to;
@@ -265,6 +635,7 @@ public:
 	void scale_diffusion_across(Species &s, T& geometry, const double scaling_factor) {
 		std::vector<int> slice;
 		subvolumes.get_slice(geometry,slice);
+		dependency_graph_valid = false;
 		const int n = slice.size();
 		for (int i = 0; i < n; ++i) {
 			const std::vector<int>& neighbrs = subvolumes.get_neighbour_indicies(slice[i]);
@@ -276,10 +647,7 @@ public:
 					lhs.push_back(ReactionComponent(1.0,s,slice[i]));
 					ReactionSide rhs;
 					rhs.push_back(ReactionComponent(1.0,s,neighbrs[j]));
-					const double rate = subvolume_reactions[slice[i]].delete_reaction(ReactionEquation(lhs,rhs));
-					if (scaling_factor > 0) {
-						subvolume_reactions[slice[i]].add_reaction(rate*scaling_factor,ReactionEquation(lhs,rhs));
-					}
+					subvolume_reactions[slice[i]].scale_reaction(ReactionEquation(lhs,rhs),scaling_factor);
 				}
 				if (geometry.lineXsurface(subvolumes.get_cell_centre(neighbrs[j]),
 						subvolumes.get_cell_centre(slice[i]))) {
@@ -287,10 +655,7 @@ public:
 					lhs.push_back(ReactionComponent(1.0,s,neighbrs[j]));
 					ReactionSide rhs;
 					rhs.push_back(ReactionComponent(1.0,s,slice[i]));
-					const double rate = subvolume_reactions[neighbrs[j]].delete_reaction(ReactionEquation(lhs,rhs));
-					if (scaling_factor > 0) {
-						subvolume_reactions[slice[i]].add_reaction(rate*scaling_factor,ReactionEquation(lhs,rhs));
-					}
+					subvolume_reactions[neighbrs[j]].scale_reaction(ReactionEquation(lhs,rhs),scaling_factor);
 					reset_priority(neighbrs[j]);
 				}
 			}
@@ -305,15 +670,108 @@ public:
 			//subvolume_reactions[i].clear();
 			subvolume_reactions[*i].clear();
 		}
+		dependency_graph_valid = false;
 	}
+	/*
+	 * hand subvolumes over to an operator that simulates them some other
+	 * way (see FiniteVolumeMethod), and take them back. A suspended
+	 * subvolume has no reactions (its own are kept aside until it is
+	 * resumed), so molecules that jump into it stay there until the other
+	 * operator collects them. Reactions added while a subvolume is
+	 * suspended are lost when it is resumed. Only the dependencies of the
+	 * subvolumes given are updated, the rest of the graph is kept
+	 */
+	virtual void suspend_subvolumes(const std::vector<int>& indicies);
+	virtual void resume_subvolumes(const std::vector<int>& indicies);
+	bool is_suspended(const int i) const { return suspended_reactions.count(i) > 0; }
 	void fill_uniform(Species& s, const Vect3d low, const Vect3d high, const unsigned int N);
 
-	void reset_all_priorities();
+	virtual void reset_all_priorities();
 	void reset_priority(const int i);
+	void reset_priorities(std::vector<int>& indicies);
 	void recalc_priority(const int i);
+	/*
+	 * for operators that change the copy numbers of subvolume i outside
+	 * of this NSM: its propensities and event time are updated at the
+	 * start of the next step, together with those of every other subvolume
+	 * marked since the last one
+	 */
+	void mark_cell_dirty(const int i) {
+		ASSERT(!cell_running_in_background(i),"cell "<<i<<" is being updated on another thread, it must be an interface cell");
+		dirty_cells.mark(i);
+		if (watch_changed_cells) changed_cells.mark(i);
+	}
+	void flush_dirty_cells();
+	/*
+	 * for operators that act when a copy number crosses a threshold (see
+	 * FiniteVolumeMethod): while watching, get_changed_cells() collects
+	 * the subvolumes whose copy numbers were changed by events or marked
+	 * dirty, until the operator clears it
+	 */
+	void set_watch_changed_cells(const bool watch) {
+		watch_changed_cells = watch;
+		changed_cells.clear();
+	}
+	DirtyCells& get_changed_cells() { return changed_cells; }
+	void set_indexed_heap(const bool use);
+	void set_propensity_sum_tree(const bool use);
+	/*
+	 * Next Reaction Method: when the propensity of a subvolume changes
+	 * because of an event elsewhere, rescale its pending event time by
+	 * old/new propensity instead of drawing a new one (Gibson & Bruck)
+	 */
+	void set_time_rescaling(const bool use) { use_time_rescaling = use; }
+	bool get_time_rescaling() const { return use_time_rescaling; }
+	/*
+	 * sparse mode, for large and mostly empty domains: subvolumes that
+	 * cannot react hold no propensities (they are freed when priorities
+	 * are reset and recalculated when a molecule arrives), and there is no
+	 * per-subvolume dependency graph, the reactions that depend on a copy
+	 * number are looked up in the shared template of its subvolume. The
+	 * copy numbers are paged (see CopyNumberStore), and resetting the
+	 * priorities only visits the allocated pages and the subvolumes that
+	 * can react without molecules. The parallel NSM turns paging off
+	 */
+	void set_sparse(const bool use) {
+		sparse = use;
+		copy_numbers->set_paged(use);
+		dependency_graph_valid = false;
+	}
+	bool get_sparse() const { return sparse; }
+	/*
+	 * keep the copy numbers of the species in 16 bit integers while they
+	 * fit, see CopyNumberStore. Returns whether they are
+	 */
+	bool set_narrow_copy_numbers(const bool use) { return copy_numbers->set_narrow(use); }
+	bool get_narrow_copy_numbers() const { return copy_numbers->get_narrow(); }
+	/*
+	 * count the events fired in each subvolume, by channel type and by the
+	 * species they consume, to see where the events are spent. Off by
+	 * default, turning them on zeroes the counts
+	 */
+	void set_activity_counters(const bool use);
+	bool get_activity_counters() const { return count_activity; }
+	void reset_activity_counters();
+	/*
+	 * number of events of channels of type in each subvolume
+	 */
+	std::vector<unsigned long> get_activity(const ReactionList::ChannelType type) const;
+	/*
+	 * number of events consuming s in each subvolume
+	 */
+	std::vector<unsigned long> get_activity(const Species& s) const;
+	/*
+	 * the vtk grid of the subvolumes (which must be a StructuredGrid), with
+	 * the counts as cell data
+	 */
+	vtkSmartPointer<vtkUnstructuredGrid> get_vtk_activity();
+	void build_dependency_graph();
+	bool get_indexed_heap() const { return use_indexed_heap; }
+	unsigned long get_number_of_events() const { return number_of_events; }
+	int get_number_of_reaction_templates() const { return reaction_templates.size(); }
 	double get_next_event_time() {
-		if (!heap.empty()) {
-			return heap.top().time_at_next_reaction;
+		if (!queue_empty()) {
+			return queue_top().time_at_next_reaction;
 		} else {
 			return INFINITY;
 		}
@@ -328,15 +786,213 @@ protected:
 	virtual void reset_execute();
 	virtual void integrate(const double dt);
 	virtual void print(std::ostream& out) const;
-private:
-	void react(ReactionEquation& r);
+
+	/*
+	 * add_reaction_to_compartment without updating the priority of subvolume i
+	 */
+	void install_reaction(const double rate, ReactionEquation eq, const int i, const RateParameter* parameter = NULL);
+	void add_reaction_to_compartments(RateParameter& rate, ReactionEquation eq, const std::vector<int>& indicies);
+	void use_rate_parameter(RateParameter& rate);
+	void install_reactions(const std::vector<double>& rates, const std::vector<ReactionEquation>& equations,
+			const RateParameter* parameter);
+	void install_diffusion(const std::vector<Species*>& species, const int i);
+	/*
+	 * the neighbour pattern (offsets and laplace coefficients) of subvolume
+	 * i, whether subvolume i has the given pattern, and the hash of its
+	 * template and pattern
+	 */
+	void get_diffusion_pattern(const int i, std::vector<std::pair<int,double> >& pattern) const;
+	bool has_diffusion_pattern(const int i, const std::vector<std::pair<int,double> >& pattern) const;
+	std::size_t diffusion_pattern_hash(const int i) const;
+
+	void react(const int sv_i, const int k);
+	/*
+	 * apply reaction k of the stoichiometry table of reactions, updating the
+	 * propensities that depend on the changed copy numbers and adding their
+	 * subvolumes to dirty_subvolumes
+	 */
+	void fire(const ReactionList& reactions, const int k);
+	/*
+	 * apply entry e, with a negative compartment index, of the reaction
+	 * starting at entry begin: take a molecule from a ghost cell, or place
+	 * one off the lattice
+	 */
+	void fire_across_interface(const ReactionList& reactions, const int begin, const int e,
+			std::vector<std::pair<int,double> >& dirty);
+	void reset_propensities(const int i);
+	/*
+	 * whether a reaction of subvolume i has all of its reactants, from
+	 * the lhs index of its template and without calculating propensities
+	 */
+	bool has_reactants(const int i) const;
+	void reset_occupied_priorities();
+	/*
+	 * add n firings of channel k in subvolume sv_i to the activity
+	 * counters. Only the counts of sv_i are written, so subdomains of
+	 * the parallel NSM can count concurrently
+	 */
+	void count_event(const int sv_i, const int k, const unsigned long n = 1) {
+		const ReactionList& reactions = subvolume_reactions[sv_i];
+		channel_activity[sv_i*ReactionList::NUMBER_OF_CHANNEL_TYPES + reactions.get_channel_type(k)] += n;
+		const StoichiometryTable& table = reactions.get_stoichiometry();
+		const int end = table.offsets[k+1];
+		for (int e = table.offsets[k]; e < end; ++e) {
+			if (table.delta[e] < 0) {
+				species_activity[table.species[e]->copy_numbers.get_slot()][sv_i] += n;
+			}
+		}
+	}
+	void size_activity_counters();
+	/*
+	 * give subvolume i a new event time after its propensity changed,
+	 * engines without an event queue override these
+	 */
+	virtual void schedule(const int i, const bool in_queue);
+	virtual void reschedule(const int i, const double old_propensity);
+	/*
+	 * true if another thread may be changing the copy numbers of subvolume i
+	 */
+	virtual bool cell_running_in_background(const int i) const { return false; }
+	/*
+	 * mark the subvolumes using a rate parameter whose value changed since
+	 * the last step as dirty
+	 */
+	void refresh_rate_parameters();
+	int get_copy_number_key(const Species* s, const int compartment_index) const;
+	void mark_dirty(const int i) {
+		mark_dirty(i,dirty_subvolumes);
+	}
+	void mark_dirty(const int i, std::vector<std::pair<int,double> >& dirty);
+	void changed_copy_number(Species& s, const int compartment_index) {
+		changed_copy_number(get_copy_number_key(&s,compartment_index),dirty_subvolumes);
+	}
+	void changed_copy_number(const int key, std::vector<std::pair<int,double> >& dirty);
+	/*
+	 * mark the subvolumes of the reactions whose propensities depend on copy
+	 * number key in dirty, without updating the propensities
+	 */
+	void mark_dependent_subvolumes(const int key, DirtyCells& dirty) const;
+	int pick_ghost_molecule(Species& s, const int ghost_index);
+
+	/*
+	 * event queue, either the boost pairing heap or the flat indexed heap
+	 */
+	bool queue_empty() const {
+		return use_indexed_heap ? flat_heap.empty() : heap.empty();
+	}
+	const HeapNode& queue_top() const {
+		return use_indexed_heap ? flat_heap.top() : heap.top();
+	}
+	double queue_get_time(const int i) const {
+		return use_indexed_heap ? flat_heap.get(i).time_at_next_reaction : (*subvolume_heap_handles[i]).time_at_next_reaction;
+	}
+	void queue_push(const int i, const double time_at_next_reaction) {
+		if (use_indexed_heap) {
+			flat_heap.push(HeapNode(time_at_next_reaction,i));
+		} else {
+			subvolume_heap_handles[i] = heap.push(HeapNode(time_at_next_reaction,i));
+		}
+	}
+	void queue_update(const int i, const double time_at_next_reaction) {
+		if (use_indexed_heap) {
+			flat_heap.update(HeapNode(time_at_next_reaction,i));
+		} else {
+			(*subvolume_heap_handles[i]).time_at_next_reaction = time_at_next_reaction;
+			heap.update(subvolume_heap_handles[i]);
+		}
+	}
+	void queue_erase(const int i) {
+		if (use_indexed_heap) {
+			flat_heap.erase(i);
+		} else {
+			heap.erase(subvolume_heap_handles[i]);
+		}
+	}
+
 	Grid& subvolumes;
+	bool use_indexed_heap;
+	bool use_sum_tree;
+	bool use_time_rescaling;
+	bool sparse;
+	unsigned long number_of_events;
 	PriorityHeap heap;
+	FlatPriorityHeap flat_heap;
+
+	/*
+	 * dependency graph from (species, compartment) to the reactions whose
+	 * propensities depend on that copy number. The dependents of compartment
+	 * c of the species in slot s are dependencies[dependency_offsets[s*n+c]]
+	 * to dependencies[dependency_offsets[s*n+c+1]-1], with n = number of
+	 * subvolumes. Rebuilt in integrate() after the reactions change, together
+	 * with the stoichiometry tables of the reaction lists. The reactions of
+	 * a suspended subvolume stay in the graph with reaction_index -(r+1),
+	 * so that suspending and resuming it only flips its own entries.
+	 */
+	struct DependentReaction {
+		DependentReaction(const int subvolume_index, const int reaction_index):
+			subvolume_index(subvolume_index),reaction_index(reaction_index) {}
+		int subvolume_index;
+		int reaction_index;
+	};
+	const ReactionList& get_dependency_reactions(const int i) const;
+	void set_dependencies_enabled(const int i, const bool enabled);
+	bool dependency_graph_valid;
+	std::vector<int> species_slots;
+	std::vector<int> dependency_offsets;
+	std::vector<DependentReaction> dependencies;
+
+	/*
+	 * in sparse mode only the reactions whose lhs is in another subvolume
+	 * are listed, keyed by copy number
+	 */
+	void build_sparse_dependency_graph();
+	int dependency_generation;
+	std::unordered_map<int,std::vector<DependentReaction> > remote_dependencies;
+	std::vector<int> reacting_without_molecules;
+	std::vector<int> occupied_subvolumes;
+	std::vector<std::pair<int,double> > dirty_subvolumes;
+	std::vector<int> ghost_indices;
+	std::vector<int> neighbour_order;
+	std::vector<HeapNode> queue_nodes;
 	boost::variate_generator<base_generator_type&, boost::uniform_real<> > uni;
 	double time;
+
+	/*
+	 * the rate parameters of the reactions, each with the version its
+	 * propensities were last calculated with and the subvolumes using it
+	 * (found when the dependency graph is built)
+	 */
+	struct RateParameterUse {
+		RateParameterUse(const RateParameter* parameter):
+			parameter(parameter),version(parameter->get_version()) {}
+		const RateParameter* parameter;
+		unsigned long version;
+		std::vector<int> cells;
+	};
+	void find_rate_parameter_cells();
+	std::vector<RateParameterUse> rate_parameters;
+
+	/*
+	 * events per subvolume and channel type, and per copy number slot and
+	 * subvolume
+	 */
+	bool count_activity;
+	std::vector<unsigned long> channel_activity;
+	std::vector<std::vector<unsigned long> > species_activity;
+
+	DirtyCells dirty_cells;
+	std::vector<double> dirty_cell_propensities;
+	bool watch_changed_cells;
+	DirtyCells changed_cells;
+
+	/*
+	 * copy numbers of all the species of this NSM, stored cell-major
+	 */
+	std::shared_ptr<CopyNumberStore> copy_numbers;
+	ReactionTemplates reaction_templates;
 	std::vector<ReactionList> subvolume_reactions;
-	std::vector<ReactionList> saved_subvolume_reactions;
 	std::vector<HeapHandle> subvolume_heap_handles;
+	std::unordered_map<int,ReactionList> suspended_reactions;
 };
 
 
@@ -53,6 +53,10 @@ public:
 
 	bool get_active() { return active;};
 	void set_active(bool a) { active = a; };
+	/*
+	 * wait for any work this operator left running in the background
+	 */
+	virtual void synchronise() {}
 
 protected:
 	virtual void add_species_execute(Species &s);
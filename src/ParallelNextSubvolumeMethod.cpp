@@ -0,0 +1,669 @@
+/*
+ * ParallelNextSubvolumeMethod.cpp
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "ParallelNextSubvolumeMethod.h"
+#include "Log.h"
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <boost/foreach.hpp>
+
+namespace Tyche {
+
+ParallelNextSubvolumeMethod::ParallelNextSubvolumeMethod(Grid& subvolumes):
+		NextSubvolumeMethod(subvolumes),
+		number_of_subdomains(4),
+		window(0),
+		partition_valid(false),
+		decomposable(false),
+		number_of_transfers(0),
+		number_of_rollbacks(0),
+		asynchronous(false) {
+	set_indexed_heap(true);
+}
+
+ParallelNextSubvolumeMethod::~ParallelNextSubvolumeMethod() {
+	synchronise();
+}
+
+void ParallelNextSubvolumeMethod::set_asynchronous(const bool use) {
+	synchronise();
+	asynchronous = use;
+	partition_valid = false;
+}
+
+void ParallelNextSubvolumeMethod::add_interface_region(const Geometry& geometry) {
+	synchronise();
+	std::vector<int> cells;
+	subvolumes.get_region(geometry,cells);
+	interface_region.insert(interface_region.end(),cells.begin(),cells.end());
+	partition_valid = false;
+}
+
+void ParallelNextSubvolumeMethod::synchronise() {
+	if (!interior.joinable()) return;
+	interior.join();
+	BOOST_FOREACH(Species* s, get_species()) {
+		if (s->background == this) s->background = NULL;
+	}
+	BOOST_FOREACH(Subdomain& sd, subdomains) {
+		mark_changed_cells(sd);
+	}
+	exchange(time);
+	store_queues();
+}
+
+/*
+ * the partition is kept, a suspended subvolume has no channels crossing
+ * between subdomains, and a resumed one only needs repartitioning if its
+ * reactions don't fit the subdomain it is in
+ */
+void ParallelNextSubvolumeMethod::suspend_subvolumes(const std::vector<int>& indicies) {
+	NextSubvolumeMethod::suspend_subvolumes(indicies);
+	if (!partition_valid || crossing_channels.empty()) return;
+	int kept = 0;
+	BOOST_FOREACH(const CrossingChannel& channel, crossing_channels) {
+		if (!is_suspended(channel.subvolume)) crossing_channels[kept++] = channel;
+	}
+	crossing_channels.resize(kept,CrossingChannel(0,0,0));
+}
+
+void ParallelNextSubvolumeMethod::resume_subvolumes(const std::vector<int>& indicies) {
+	NextSubvolumeMethod::resume_subvolumes(indicies);
+	if (!partition_valid || !dependency_graph_valid) return;
+	BOOST_FOREACH(int i, indicies) {
+		if (decomposable && !(asynchronous ? can_run_asynchronously(i) : can_decompose(i))) {
+			partition_valid = false;
+			return;
+		}
+		if (!asynchronous) add_crossing_channels(i);
+	}
+}
+
+void ParallelNextSubvolumeMethod::reset_execute() {
+	synchronise();
+	NextSubvolumeMethod::reset_execute();
+}
+
+void ParallelNextSubvolumeMethod::integrate(const double dt) {
+	synchronise();
+	if (!dependency_graph_valid) {
+		build_dependency_graph();
+		partition_valid = false;
+	}
+	if (!partition_valid) partition();
+	if (!decomposable) {
+		NextSubvolumeMethod::integrate(dt);
+		return;
+	}
+	ASSERT(get_indexed_heap(),"ParallelNextSubvolumeMethod needs the indexed heap");
+
+	/*
+	 * subdomains write copy numbers concurrently, which a narrow or paged
+	 * store can't take if one of them needs promoting or a new page
+	 */
+	copy_numbers->set_narrow(false);
+	copy_numbers->set_paged(false);
+
+	refresh_rate_parameters();
+	flush_dirty_cells();
+	load_queues();
+	const int nd = subdomains.size();
+	const double final_time = time + dt;
+	if (asynchronous) {
+		interior = std::thread(&ParallelNextSubvolumeMethod::run_subdomain,this,0,final_time);
+		BOOST_FOREACH(Species* s, get_species()) {
+			s->background = this;
+		}
+		run_subdomain(1,final_time);
+		time = final_time;
+		return;
+	}
+	const double window_dt = window > 0 ? window : get_automatic_window();
+	while (time < final_time) {
+		const double window_end = std::min(time + window_dt, final_time);
+		do {
+			#pragma omp parallel for schedule(dynamic,1)
+			for (int d = 0; d < nd; ++d) {
+				run_subdomain(d,window_end);
+			}
+		} while (!route_transfers());
+		commit_window();
+		time = window_end;
+	}
+	time = final_time;
+	store_queues();
+}
+
+bool ParallelNextSubvolumeMethod::can_decompose() const {
+	const int n = subvolumes.size();
+	for (int i = 0; i < n; ++i) {
+		if (!can_decompose(i)) return false;
+	}
+	return true;
+}
+
+bool ParallelNextSubvolumeMethod::can_decompose(const int i) const {
+	/*
+	 * every reaction must only take molecules from, and change the
+	 * propensities of, the cell it belongs to
+	 */
+	const ReactionList& reactions = subvolume_reactions[i];
+	const StoichiometryTable& table = reactions.get_stoichiometry();
+	const int ne = table.species.size();
+	for (int e = 0; e < ne; ++e) {
+		const int c = reactions.get_compartment_index(e);
+		if ((c < 0) || ((table.delta[e] < 0) && (c != i))) return false;
+	}
+	return true;
+}
+
+bool ParallelNextSubvolumeMethod::can_run_asynchronously() const {
+	const int n = subvolumes.size();
+	for (int i = 0; i < n; ++i) {
+		if (!can_run_asynchronously(i)) return false;
+	}
+	return true;
+}
+
+bool ParallelNextSubvolumeMethod::can_run_asynchronously(const int i) const {
+	/*
+	 * every reaction must only take molecules from the cell it belongs to
+	 * (a ghost cell takes them from itself), and only interface cells may
+	 * reach off the lattice
+	 */
+	const ReactionList& reactions = subvolume_reactions[i];
+	const StoichiometryTable& table = reactions.get_stoichiometry();
+	const int ne = table.species.size();
+	for (int e = 0; e < ne; ++e) {
+		const int c = reactions.get_compartment_index(e);
+		if ((table.delta[e] < 0) && (std::abs(c) != i)) return false;
+		if ((c < 0) && ((owner[i] != 1) || ((table.tmp[e] < 0) && (owner[-c] != 1)))) return false;
+	}
+	return true;
+}
+
+void ParallelNextSubvolumeMethod::partition_interface() {
+	const int n = subvolumes.size();
+	owner.assign(n,0);
+	BOOST_FOREACH(int i, interface_region) {
+		owner[i] = 1;
+	}
+	for (int i = 0; i < n; ++i) {
+		const ReactionList& reactions = subvolume_reactions[i];
+		const StoichiometryTable& table = reactions.get_stoichiometry();
+		const int ne = table.species.size();
+		for (int e = 0; e < ne; ++e) {
+			const int c = reactions.get_compartment_index(e);
+			if (c < 0) {
+				owner[i] = 1;
+				if (table.tmp[e] < 0) owner[-c] = 1;
+			}
+		}
+	}
+	decomposable = can_run_asynchronously();
+	if (!decomposable) {
+		LOG(1,"ParallelNextSubvolumeMethod: reactions reach outside their cell, using the serial method");
+	}
+
+	subdomains.assign(2,Subdomain());
+	local_index.resize(n);
+	for (int i = 0; i < n; ++i) {
+		local_index[i] = subdomains[owner[i]].cells.size();
+		subdomains[owner[i]].cells.push_back(i);
+	}
+	exchanged_propensities.assign(n,-1);
+	crossing_channels.clear();
+	partition_valid = true;
+}
+
+void ParallelNextSubvolumeMethod::partition() {
+	if (asynchronous) {
+		partition_interface();
+		return;
+	}
+	const int n = subvolumes.size();
+	const int nd = std::max(1,std::min(number_of_subdomains,n));
+	decomposable = can_decompose();
+	if (!decomposable) {
+		LOG(1,"ParallelNextSubvolumeMethod: reactions reach outside their cell, using the serial method");
+	}
+
+	/*
+	 * slabs of equal numbers of cells along the longest axis of the grid
+	 */
+	const Vect3d extent = subvolumes.get_high() - subvolumes.get_low();
+	int axis = 0;
+	for (int k = 1; k < 3; ++k) {
+		if (extent[k] > extent[axis]) axis = k;
+	}
+	std::vector<std::pair<double,int> > order(n);
+	for (int i = 0; i < n; ++i) {
+		order[i] = std::make_pair(subvolumes.get_cell_centre(i)[axis],i);
+	}
+	std::sort(order.begin(),order.end());
+
+	subdomains.assign(nd,Subdomain());
+	owner.resize(n);
+	local_index.resize(n);
+	for (int k = 0; k < n; ++k) {
+		const int i = order[k].second;
+		const int d = (long(k)*nd)/n;
+		owner[i] = d;
+		local_index[i] = subdomains[d].cells.size();
+		subdomains[d].cells.push_back(i);
+	}
+	exchanged_propensities.assign(n,-1);
+
+	arrivals.assign(nd,std::vector<Transfer>());
+
+	/*
+	 * the rhs of the channels that cross between subdomains, to set the
+	 * default window
+	 */
+	crossing_channels.clear();
+	for (int i = 0; i < n; ++i) {
+		add_crossing_channels(i);
+	}
+	partition_valid = true;
+}
+
+void ParallelNextSubvolumeMethod::add_crossing_channels(const int i) {
+	const ReactionList& reactions = subvolume_reactions[i];
+	const StoichiometryTable& table = reactions.get_stoichiometry();
+	const std::vector<ReactionsWithSameRateAndLHS>& channels = reactions.get_reactions();
+	const int nr = channels.size();
+	for (int r = 0; r < nr; ++r) {
+		const int first_rhs = reactions.get_rhs_offset(r);
+		const int nrhs = reactions.get_rhs_offset(r+1) - first_rhs;
+		double fraction = 0;
+		for (int j = 0; j < nrhs; ++j) {
+			const int end = table.offsets[first_rhs+j+1];
+			for (int e = table.offsets[first_rhs+j]; e < end; ++e) {
+				const int c = reactions.get_compartment_index(e);
+				if ((c >= 0) && (owner[c] != owner[i])) {
+					fraction += channels[r].get_rhs_fraction(j);
+					break;
+				}
+			}
+		}
+		if (fraction > 0) crossing_channels.push_back(CrossingChannel(i,r,fraction));
+	}
+}
+
+double ParallelNextSubvolumeMethod::get_automatic_window() const {
+	/*
+	 * about one transfer per subdomain in a window, at the current
+	 * propensity of the crossing channels
+	 */
+	double propensity = 0;
+	BOOST_FOREACH(const CrossingChannel& channel, crossing_channels) {
+		// the sparse mode frees the propensities of subvolumes that can't react
+		const ReactionList& reactions = subvolume_reactions[channel.subvolume];
+		if (reactions.get_propensity() == 0) continue;
+		propensity += channel.fraction*reactions.get_reaction_propensity(channel.reaction);
+	}
+	return propensity > 0 ? subdomains.size()/propensity : std::numeric_limits<double>::infinity();
+}
+
+void ParallelNextSubvolumeMethod::load_queues() {
+	/*
+	 * take the event times from the serial queue, which also holds any
+	 * changes made through reset_priority/recalc_priority or the dirty
+	 * subvolumes since the last step. Each subdomain gets its own stream
+	 * seeded from the global generator, so runs do not depend on the
+	 * number of threads
+	 */
+	const int nd = subdomains.size();
+	for (int d = 0; d < nd; ++d) {
+		Subdomain& sd = subdomains[d];
+		const int nc = sd.cells.size();
+		sd.heap.reset(nc);
+		for (int l = 0; l < nc; ++l) {
+			const int i = sd.cells[l];
+			if (flat_heap.contains(i)) {
+				sd.heap.push(HeapNode(flat_heap.get(i).time_at_next_reaction,l));
+			}
+		}
+		sd.stream = (uint64_t(generator()) << 32) | uint64_t(generator());
+		sd.draws = 0;
+		sd.next_incoming = 0;
+		sd.events = 0;
+	}
+}
+
+void ParallelNextSubvolumeMethod::store_queues() {
+	const int nd = subdomains.size();
+	for (int d = 0; d < nd; ++d) {
+		Subdomain& sd = subdomains[d];
+		const int nc = sd.cells.size();
+		for (int l = 0; l < nc; ++l) {
+			const int i = sd.cells[l];
+			if (sd.heap.contains(l)) {
+				const double t = sd.heap.get(l).time_at_next_reaction;
+				if (flat_heap.contains(i)) {
+					queue_update(i,t);
+				} else {
+					queue_push(i,t);
+				}
+			} else if (flat_heap.contains(i)) {
+				queue_erase(i);
+			}
+		}
+		number_of_events += sd.events;
+	}
+}
+
+double ParallelNextSubvolumeMethod::uniform(Subdomain& sd) {
+	uint64_t z = sd.stream + (++sd.draws)*0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	return (z >> 11)*(1.0/9007199254740992.0);
+}
+
+void ParallelNextSubvolumeMethod::run_subdomain(const int d, const double final_time) {
+	/*
+	 * events and delivered transfers are logged, so that they can be
+	 * undone, except in asynchronous mode
+	 */
+	Subdomain& sd = subdomains[d];
+	const int ni = sd.incoming.size();
+	while (true) {
+		const double t = sd.heap.empty() ? std::numeric_limits<double>::infinity() : sd.heap.top().time_at_next_reaction;
+		if ((sd.next_incoming < ni) && (sd.incoming[sd.next_incoming].time <= std::min(t,final_time))) {
+			deliver(d);
+			continue;
+		}
+		if (t > final_time) break;
+		const int sv_i = sd.cells[sd.heap.top().subvolume_index];
+		if (!asynchronous) log_event(d,t,sv_i,false);
+		ReactionList& reactions = subvolume_reactions[sv_i];
+		const int k = reactions.pick_random_reaction(uniform(sd));
+		if (!asynchronous) {
+			sd.log.back().k = k;
+		} else {
+			sd.events++;
+			if (count_activity) count_event(sv_i,k);
+		}
+		sd.dirty.clear();
+		mark_dirty(sv_i,sd.dirty);
+		fire_in_subdomain(d,reactions,k,t);
+
+		const int n = sd.dirty.size();
+		for (int j = 0; j < n; ++j) {
+			const int i = sd.dirty[j].first;
+			if (i == sv_i) {
+				schedule_in_subdomain(d,i,t);
+			} else if (subvolume_reactions[i].get_propensity() != sd.dirty[j].second) {
+				reschedule_in_subdomain(d,i,t,sd.dirty[j].second);
+			}
+		}
+	}
+}
+
+void ParallelNextSubvolumeMethod::fire_in_subdomain(const int d, const ReactionList& reactions, const int k, const double t) {
+	Subdomain& sd = subdomains[d];
+	const StoichiometryTable& table = reactions.get_stoichiometry();
+	const int end = table.offsets[k+1];
+	for (int e = table.offsets[k]; e < end; ++e) {
+		const int c = reactions.get_compartment_index(e);
+		if (c < 0) {
+			fire_across_interface(reactions,table.offsets[k],e,sd.dirty);
+			continue;
+		}
+		if (owner[c] == d) {
+			change_copy_number(d,*table.species[e],c,table.delta[e]);
+		} else {
+			sd.outgoing.push_back(Transfer(t,table.species[e],c,table.delta[e]));
+		}
+	}
+}
+
+void ParallelNextSubvolumeMethod::deliver(const int d) {
+	Subdomain& sd = subdomains[d];
+	const Transfer& transfer = sd.incoming[sd.next_incoming++];
+	const double t = transfer.time;
+	log_event(d,t,transfer.c,true);
+	sd.dirty.clear();
+	change_copy_number(d,*transfer.species,transfer.c,transfer.n);
+	const int n = sd.dirty.size();
+	for (int j = 0; j < n; ++j) {
+		const int i = sd.dirty[j].first;
+		if (subvolume_reactions[i].get_propensity() != sd.dirty[j].second) {
+			reschedule_in_subdomain(d,i,t,sd.dirty[j].second);
+		}
+	}
+}
+
+void ParallelNextSubvolumeMethod::change_copy_number(const int d, Species& s, const int c, const int n) {
+	Subdomain& sd = subdomains[d];
+	s.copy_numbers[c] += n;
+	if (!asynchronous || watch_changed_cells) sd.changes.push_back(Change(&s,c,n));
+	changed_copy_number(get_copy_number_key(&s,c),sd.dirty);
+}
+
+void ParallelNextSubvolumeMethod::log_event(const int d, const double t, const int sv_i, const bool delivered) {
+	Subdomain& sd = subdomains[d];
+	LoggedEvent event;
+	event.time = t;
+	event.subvolume = sv_i;
+	event.k = -1;
+	event.delivered = delivered;
+	event.draws = sd.draws;
+	event.first_change = sd.changes.size();
+	event.first_node = sd.replaced_nodes.size();
+	event.first_outgoing = sd.outgoing.size();
+	sd.log.push_back(event);
+}
+
+void ParallelNextSubvolumeMethod::replace_node(const int d, const int l) {
+	if (asynchronous) return;
+	Subdomain& sd = subdomains[d];
+	const bool queued = sd.heap.contains(l);
+	sd.replaced_nodes.push_back(ReplacedNode(l,queued,queued ? sd.heap.get(l).time_at_next_reaction : 0));
+}
+
+void ParallelNextSubvolumeMethod::schedule_in_subdomain(const int d, const int i, const double t) {
+	Subdomain& sd = subdomains[d];
+	const int l = local_index[i];
+	replace_node(d,l);
+	const double total_propensity = subvolume_reactions[i].get_propensity();
+	if (total_propensity != 0) {
+		double rand = uniform(sd);
+		while (rand==0.0) rand = uniform(sd);
+		const HeapNode node(t - log(rand)/total_propensity,l);
+		if (sd.heap.contains(l)) {
+			sd.heap.update(node);
+		} else {
+			sd.heap.push(node);
+		}
+	} else if (sd.heap.contains(l)) {
+		sd.heap.erase(l);
+	}
+}
+
+void ParallelNextSubvolumeMethod::reschedule_in_subdomain(const int d, const int i, const double t, const double old_propensity) {
+	Subdomain& sd = subdomains[d];
+	const int l = local_index[i];
+	const double total_propensity = subvolume_reactions[i].get_propensity();
+	if (get_time_rescaling() && (old_propensity != 0) && (total_propensity != 0)) {
+		replace_node(d,l);
+		const double old_time = sd.heap.get(l).time_at_next_reaction;
+		sd.heap.update(HeapNode(t + (old_propensity/total_propensity)*(old_time - t),l));
+	} else {
+		schedule_in_subdomain(d,i,t);
+	}
+}
+
+bool ParallelNextSubvolumeMethod::route_transfers() {
+	/*
+	 * give every subdomain the transfers sent to it in this round. One that
+	 * ran with different transfers rolls back to the first difference, and
+	 * the window is done once none has to
+	 */
+	const int nd = subdomains.size();
+	for (int d = 0; d < nd; ++d) {
+		arrivals[d].clear();
+	}
+	for (int d = 0; d < nd; ++d) {
+		BOOST_FOREACH(const Transfer& transfer, subdomains[d].outgoing) {
+			arrivals[owner[transfer.c]].push_back(transfer);
+		}
+	}
+	bool done = true;
+	for (int d = 0; d < nd; ++d) {
+		Subdomain& sd = subdomains[d];
+		std::vector<Transfer>& arriving = arrivals[d];
+		std::stable_sort(arriving.begin(),arriving.end());
+		if (arriving == sd.incoming) continue;
+		done = false;
+		const int na = arriving.size();
+		const int ni = sd.incoming.size();
+		int k = 0;
+		while ((k < na) && (k < ni) && (arriving[k] == sd.incoming[k])) ++k;
+		double t = std::numeric_limits<double>::infinity();
+		if (k < ni) t = sd.incoming[k].time;
+		if (k < na) t = std::min(t,arriving[k].time);
+		roll_back(d,t);
+		sd.incoming.swap(arriving);
+		ASSERT(sd.next_incoming <= k,"transfers delivered after the roll back time");
+	}
+	return done;
+}
+
+void ParallelNextSubvolumeMethod::roll_back(const int d, const double t) {
+	Subdomain& sd = subdomains[d];
+	if (sd.log.empty() || (sd.log.back().time < t)) return;
+	number_of_rollbacks++;
+	while (!sd.log.empty() && (sd.log.back().time >= t)) {
+		const LoggedEvent& event = sd.log.back();
+		sd.dirty.clear();
+		for (int c = sd.changes.size()-1; c >= event.first_change; --c) {
+			const Change& change = sd.changes[c];
+			change.species->copy_numbers[change.c] -= change.n;
+			changed_copy_number(get_copy_number_key(change.species,change.c),sd.dirty);
+		}
+		sd.changes.erase(sd.changes.begin()+event.first_change,sd.changes.end());
+		for (int r = sd.replaced_nodes.size()-1; r >= event.first_node; --r) {
+			const ReplacedNode& node = sd.replaced_nodes[r];
+			if (node.queued) {
+				const HeapNode old_node(node.time,node.l);
+				if (sd.heap.contains(node.l)) {
+					sd.heap.update(old_node);
+				} else {
+					sd.heap.push(old_node);
+				}
+			} else if (sd.heap.contains(node.l)) {
+				sd.heap.erase(node.l);
+			}
+		}
+		sd.replaced_nodes.erase(sd.replaced_nodes.begin()+event.first_node,sd.replaced_nodes.end());
+		sd.outgoing.erase(sd.outgoing.begin()+event.first_outgoing,sd.outgoing.end());
+		sd.draws = event.draws;
+		if (event.delivered) sd.next_incoming--;
+		sd.log.pop_back();
+	}
+	sd.dirty.clear();
+}
+
+void ParallelNextSubvolumeMethod::mark_changed_cells(Subdomain& sd) {
+	if (watch_changed_cells) {
+		BOOST_FOREACH(const Change& change, sd.changes) {
+			changed_cells.mark(change.c);
+		}
+	}
+	sd.changes.clear();
+}
+
+void ParallelNextSubvolumeMethod::commit_window() {
+	const int nd = subdomains.size();
+	for (int d = 0; d < nd; ++d) {
+		Subdomain& sd = subdomains[d];
+		BOOST_FOREACH(const LoggedEvent& event, sd.log) {
+			if (event.delivered) continue;
+			sd.events++;
+			if (count_activity) count_event(event.subvolume,event.k);
+		}
+		number_of_transfers += sd.incoming.size();
+		sd.log.clear();
+		mark_changed_cells(sd);
+		sd.replaced_nodes.clear();
+		sd.outgoing.clear();
+		sd.incoming.clear();
+		sd.next_incoming = 0;
+	}
+}
+
+void ParallelNextSubvolumeMethod::exchange(const double t) {
+	/*
+	 * in asynchronous mode, deliver the molecules that crossed between the
+	 * interior and the interface during the step, then give the cells whose
+	 * propensity changed new event times
+	 */
+	const int nd = subdomains.size();
+	for (int d = 0; d < nd; ++d) {
+		std::vector<Transfer>& outgoing = subdomains[d].outgoing;
+		const int nt = outgoing.size();
+		for (int k = 0; k < nt; ++k) {
+			const int c = outgoing[k].c;
+			if (exchanged_propensities[c] < 0) {
+				exchanged_propensities[c] = subvolume_reactions[c].get_propensity();
+				exchanged_cells.push_back(c);
+			}
+			outgoing[k].species->copy_numbers[c] += outgoing[k].n;
+			exchange_dirty.clear();
+			changed_copy_number(get_copy_number_key(outgoing[k].species,c),exchange_dirty);
+			if (watch_changed_cells) changed_cells.mark(c);
+		}
+		number_of_transfers += nt;
+		outgoing.clear();
+	}
+	const int nc = exchanged_cells.size();
+	for (int k = 0; k < nc; ++k) {
+		const int c = exchanged_cells[k];
+		if (subvolume_reactions[c].get_propensity() != exchanged_propensities[c]) {
+			reschedule_in_subdomain(owner[c],c,t,exchanged_propensities[c]);
+		}
+		exchanged_propensities[c] = -1;
+	}
+	exchanged_cells.clear();
+}
+
+void ParallelNextSubvolumeMethod::print(std::ostream& out) const {
+	if (!interior.joinable()) {
+		if (asynchronous) {
+			out << "\tParallel Next Subvolume Method (interior running asynchronously):"<<std::endl;
+		} else {
+			out << "\tParallel Next Subvolume Method ("<<subdomains.size()<<" subdomains):"<<std::endl;
+		}
+		NextSubvolumeMethod::print(out);
+		return;
+	}
+
+	/*
+	 * the interior thread is still writing the copy numbers of its cells,
+	 * so only count those of the interface cells
+	 */
+	out << "\tParallel Next Subvolume Method (interior running asynchronously):"<<std::endl;
+	out << "\tNext Subvolume Method:"<<std::endl;
+	out << "\t\tGrid:"<<std::endl;
+	out << "\t\t\tlow = "<<get_grid().get_low() << " high = "<<get_grid().get_high()<<std::endl;
+	out << "\t\tShared reaction templates: "<<get_number_of_reaction_templates()<<std::endl;
+	out << "\t\tDiffusing Species:"<<std::endl;
+	const int n = get_grid().size();
+	for (unsigned int i = 0; i < get_species().size(); ++i) {
+		Species *s = get_species()[i];
+		int sum = 0;
+		for (int c = 0; c < n; ++c) {
+			if (!cell_running_in_background(c)) sum += s->copy_numbers[c];
+		}
+		out <<"\t\t\tSpecies "<<s->id<<" (D = "<<s->D<<") has "<<sum<<
+					" particles in interface compartments and "<<s->mols.size()<<" off-lattice particles"<<std::endl;
+	}
+}
+
+}
@@ -0,0 +1,228 @@
+/*
+ * ParallelNextSubvolumeMethod.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef PARALLELNEXTSUBVOLUMEMETHOD_H_
+#define PARALLELNEXTSUBVOLUMEMETHOD_H_
+
+#include "NextSubvolumeMethod.h"
+#include <thread>
+#include <stdint.h>
+
+namespace Tyche {
+
+/*
+ * Next Subvolume Method with the grid split into slabs along its longest
+ * axis, 4 subdomains by default, run in parallel. Each subdomain runs its
+ * own event queue and random number stream. A molecule diffusing into
+ * another subdomain is sent to it as a transfer stamped with the time of
+ * the event. Time advances in windows: every subdomain runs optimistically
+ * to the end of the window, delivering the transfers it has received at
+ * their times. A subdomain that was sent different transfers than it ran
+ * with rolls back to the first difference (undoing its events and
+ * rewinding its stream) and runs again, until no transfer changes. The
+ * result is a trajectory of the serial method, with the random numbers of
+ * each cell taken from the stream of its subdomain, so it samples the same
+ * process. It depends on the number of subdomains and the seed, but not on
+ * the number of threads.
+ *
+ * The window only sets how much work may be rolled back. By default
+ * (window = 0) it is chosen at the start of each step from the current
+ * propensity of the channels crossing between subdomains, so that about
+ * one transfer per subdomain is expected in a window. Reactions that reach
+ * outside their own cell (e.g. ghost cell or TRM interfaces) run on the
+ * serial method instead. Narrow (16 bit) copy numbers are promoted before
+ * running in parallel.
+ *
+ * In asynchronous mode the grid is split into the interface cells (those
+ * with reactions reaching off the lattice or into ghost cells, plus any
+ * added with add_interface_region) and the interior. Each step runs the
+ * interface cells straight away and the interior on a thread of its own,
+ * which keeps running while the operators after this one (e.g. Brownian
+ * dynamics) take their step. The two exchange molecules, and the interior
+ * catches up, at the start of the next step, so molecules crossing
+ * between the two arrive up to one timestep late. Until then the species
+ * point to this operator, and anything reading their copy numbers (the
+ * outputs, run, get_compartments from Python) calls Species::synchronise()
+ * first. Operators that change the copy numbers of arbitrary cells
+ * (LatticeDiffusion, FiniteVolumeMethod, GrowingInterface) also wait for
+ * the interior, so only those that change interface cells (e.g.
+ * DiffusionWithTracking over the ghost cells, or a CouplingBoundary with
+ * its region added) overlap with it. Debug builds check this in
+ * mark_cell_dirty.
+ */
+class ParallelNextSubvolumeMethod: public NextSubvolumeMethod {
+public:
+	ParallelNextSubvolumeMethod(Grid& subvolumes);
+	virtual ~ParallelNextSubvolumeMethod();
+	static std::auto_ptr<ParallelNextSubvolumeMethod> New(const Vect3d& min, const Vect3d& max, const Vect3d& h) {
+		Grid* grid = new StructuredGrid(min,max,h);
+		return std::auto_ptr<ParallelNextSubvolumeMethod>(new ParallelNextSubvolumeMethod(*grid));
+	}
+	static std::auto_ptr<ParallelNextSubvolumeMethod> New(Grid& grid) {
+		return std::auto_ptr<ParallelNextSubvolumeMethod>(new ParallelNextSubvolumeMethod(grid));
+	}
+
+	void set_number_of_subdomains(const int n) {
+		number_of_subdomains = n;
+		partition_valid = false;
+	}
+	int get_number_of_subdomains() const { return number_of_subdomains; }
+	void set_window(const double dt) { window = dt; }
+	double get_window() const { return window; }
+	unsigned long get_number_of_transfers() const { return number_of_transfers; }
+	/*
+	 * number of times a subdomain rolled back because it was sent
+	 * different transfers
+	 */
+	unsigned long get_number_of_rollbacks() const { return number_of_rollbacks; }
+
+	void set_asynchronous(const bool use);
+	bool get_asynchronous() const { return asynchronous; }
+	/*
+	 * treat the cells in geometry as interface cells in asynchronous mode,
+	 * for operators that move molecules into them (e.g. CouplingBoundary)
+	 */
+	void add_interface_region(const Geometry& geometry);
+	/*
+	 * wait for the interior to finish its step and exchange molecules with
+	 * the interface cells
+	 */
+	virtual void synchronise();
+	virtual void suspend_subvolumes(const std::vector<int>& indicies);
+	virtual void resume_subvolumes(const std::vector<int>& indicies);
+
+protected:
+	virtual void reset_execute();
+	virtual bool cell_running_in_background(const int i) const {
+		return interior.joinable() && (owner[i] == 0);
+	}
+	virtual void integrate(const double dt);
+	virtual void print(std::ostream& out) const;
+
+private:
+	/*
+	 * n molecules of species added to cell c, at time for a transfer
+	 */
+	struct Change {
+		Change(Species* species, const int c, const int n):species(species),c(c),n(n) {}
+		Species* species;
+		int c;
+		int n;
+	};
+	struct Transfer: public Change {
+		Transfer(const double time, Species* species, const int c, const int n):Change(species,c,n),time(time) {}
+		bool operator==(const Transfer& arg) const {
+			return (time == arg.time) && (species == arg.species) && (c == arg.c) && (n == arg.n);
+		}
+		bool operator<(const Transfer& arg) const {
+			return time < arg.time;
+		}
+		double time;
+	};
+	/*
+	 * an event (reaction k of subvolume), or a delivered transfer, of the
+	 * current window. Undoing it rewinds the stream to draws and takes back
+	 * the copy number changes, replaced queue nodes and sent transfers
+	 * logged from first_change, first_node and first_outgoing on
+	 */
+	struct LoggedEvent {
+		double time;
+		int subvolume;
+		int k;
+		bool delivered;
+		uint64_t draws;
+		int first_change;
+		int first_node;
+		int first_outgoing;
+	};
+	struct ReplacedNode {
+		ReplacedNode(const int l, const bool queued, const double time):l(l),queued(queued),time(time) {}
+		int l;
+		bool queued;
+		double time;
+	};
+	/*
+	 * the stream of a subdomain is counter based, so that rolling back
+	 * only needs the number of numbers drawn
+	 */
+	struct Subdomain {
+		std::vector<int> cells;
+		FlatPriorityHeap heap;
+		uint64_t stream;
+		uint64_t draws;
+		std::vector<std::pair<int,double> > dirty;
+		std::vector<Transfer> outgoing;
+		std::vector<Transfer> incoming;
+		int next_incoming;
+		std::vector<LoggedEvent> log;
+		std::vector<Change> changes;
+		std::vector<ReplacedNode> replaced_nodes;
+		unsigned long events;
+	};
+	/*
+	 * fraction of channel reaction of subvolume that crosses into another
+	 * subdomain
+	 */
+	struct CrossingChannel {
+		CrossingChannel(const int subvolume, const int reaction, const double fraction):
+			subvolume(subvolume),reaction(reaction),fraction(fraction) {}
+		int subvolume;
+		int reaction;
+		double fraction;
+	};
+
+	bool can_decompose() const;
+	bool can_decompose(const int i) const;
+	bool can_run_asynchronously() const;
+	bool can_run_asynchronously(const int i) const;
+	void add_crossing_channels(const int i);
+	void partition();
+	void partition_interface();
+	void load_queues();
+	void store_queues();
+	double get_automatic_window() const;
+	double uniform(Subdomain& sd);
+	void run_subdomain(const int d, const double final_time);
+	void fire_in_subdomain(const int d, const ReactionList& reactions, const int k, const double t);
+	void deliver(const int d);
+	void change_copy_number(const int d, Species& s, const int c, const int n);
+	void log_event(const int d, const double t, const int sv_i, const bool delivered);
+	void replace_node(const int d, const int l);
+	void schedule_in_subdomain(const int d, const int i, const double t);
+	void reschedule_in_subdomain(const int d, const int i, const double t, const double old_propensity);
+	bool route_transfers();
+	void roll_back(const int d, const double t);
+	void mark_changed_cells(Subdomain& sd);
+	void commit_window();
+	void exchange(const double t);
+
+	int number_of_subdomains;
+	double window;
+	bool partition_valid;
+	bool decomposable;
+	unsigned long number_of_transfers;
+	unsigned long number_of_rollbacks;
+	std::vector<int> owner;
+	std::vector<int> local_index;
+	std::vector<Subdomain> subdomains;
+	std::vector<CrossingChannel> crossing_channels;
+	std::vector<std::vector<Transfer> > arrivals;
+	std::vector<int> exchanged_cells;
+	std::vector<double> exchanged_propensities;
+	std::vector<std::pair<int,double> > exchange_dirty;
+
+	/*
+	 * in asynchronous mode subdomain 0 is the interior and subdomain 1
+	 * the interface
+	 */
+	bool asynchronous;
+	std::vector<int> interface_region;
+	std::thread interior;
+};
+
+}
+
+#endif /* PARALLELNEXTSUBVOLUMEMETHOD_H_ */
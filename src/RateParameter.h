@@ -0,0 +1,50 @@
+/*
+ * RateParameter.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef RATEPARAMETER_H_
+#define RATEPARAMETER_H_
+
+#include <memory>
+
+namespace Tyche {
+
+/*
+ * a rate constant that can be changed while a simulation runs (e.g. a time
+ * dependent signal). Reactions added to a NextSubvolumeMethod with a
+ * RateParameter read its value whenever their propensity is calculated.
+ * After set_value, the NSM refreshes the propensities and event times of
+ * only the subvolumes using the parameter, at the start of its next step.
+ * Like a Species, the parameter must outlive the operators using it.
+ */
+class RateParameter {
+public:
+	RateParameter(const double value):value(value),version(0) {}
+	static std::auto_ptr<RateParameter> New(const double value) {
+		return std::auto_ptr<RateParameter>(new RateParameter(value));
+	}
+	double get_value() const {
+		return value;
+	}
+	void set_value(const double new_value) {
+		value = new_value;
+		version++;
+	}
+
+	/*
+	 * number of times the value has been set, for operators to tell
+	 * whether it changed since they last looked
+	 */
+	unsigned long get_version() const {
+		return version;
+	}
+private:
+	double value;
+	unsigned long version;
+};
+
+}
+
+#endif /* RATEPARAMETER_H_ */
@@ -54,6 +54,7 @@ void run(Species& s, double for_time, double dt BOOST_PP_COMMA_IF(n) BOOST_PP_EN
 	LOG(1, BOOST_PP_REPEAT(n, RUN_print, none) " ");
 	//BOOST_PP_REPEAT(n, RUN_start_timers, none)
 	for (int i = 0; i < iterations; ++i) {
+		s.synchronise();
 		const int nn = s.copy_numbers.size();
 		for (int ii = 0; ii < nn; ++ii) {
 			if (s.copy_numbers[ii] < 0) {
@@ -6,6 +6,7 @@
  */
 
 #include "Species.h"
+#include "Operator.h"
 #include <boost/random.hpp>
 
 #include <vtkDoubleArray.h>
@@ -40,10 +41,89 @@ vtkSmartPointer<vtkUnstructuredGrid> Molecules::get_vtk_grid() {
 
 int Molecules::delete_molecule(const unsigned int i) {
 	const int last_index = this->size()-1;
+	if (index_grid != NULL) {
+		remove_from_cell_index(i);
+		if (i != last_index) {
+			const int list = molecule_list[last_index];
+			remove_from_cell_index(last_index);
+			insert_into_cell_index(i,list);
+		}
+		molecule_list.pop_back();
+		molecule_position.pop_back();
+	}
 	if (i != last_index) {
 		(*this)[i] = (*this)[last_index];
 	}
 	this->pop_back();
+	return i;
+}
+
+void Molecules::clear() {
+	MolData::clear();
+	molecule_list.clear();
+	molecule_position.clear();
+	for (std::vector<std::vector<int> >::iterator i=cell_members.begin();i!=cell_members.end();i++) {
+		i->clear();
+	}
+}
+
+void Molecules::add_cell_index(const Grid* grid, const std::vector<int>& cells) {
+	if (grid != index_grid) {
+		index_grid = grid;
+		cell_lists.assign(grid->size(),-1);
+		cell_members.clear();
+	}
+	BOOST_FOREACH(int cell, cells) {
+		if (cell_lists[cell] < 0) {
+			cell_lists[cell] = cell_members.size();
+			cell_members.push_back(std::vector<int>());
+		}
+	}
+	update_cell_index();
+}
+
+void Molecules::update_cell_index() {
+	if (index_grid == NULL) return;
+	for (std::vector<std::vector<int> >::iterator i=cell_members.begin();i!=cell_members.end();i++) {
+		i->clear();
+	}
+	const int n = this->size();
+	molecule_list.assign(n,-1);
+	molecule_position.assign(n,-1);
+	for (int i = 0; i < n; ++i) {
+		update_cell_index(i);
+	}
+}
+
+bool Molecules::is_cell_index_consistent(const int cell) const {
+	if (!is_cell_indexed(cell)) return true;
+	const int n = this->size();
+	int number_in_cell = 0;
+	for (int i = 0; i < n; ++i) {
+		const bool in_cell = index_grid->is_in(r[i]) && (index_grid->get_cell_index(r[i]) == cell);
+		if (in_cell != (molecule_list[i] == cell_lists[cell])) return false;
+		if (in_cell) number_in_cell++;
+	}
+	return number_in_cell == get_number_in_cell(cell);
+}
+
+void Molecules::remove_from_cell_index(const unsigned int i) {
+	const int list = molecule_list[i];
+	if (list < 0) return;
+	std::vector<int>& members = cell_members[list];
+	const int p = molecule_position[i];
+	members[p] = members.back();
+	molecule_position[members[p]] = p;
+	members.pop_back();
+	molecule_list[i] = -1;
+	molecule_position[i] = -1;
+}
+
+void Molecules::insert_into_cell_index(const unsigned int i, const int list) {
+	molecule_list[i] = list;
+	if (list < 0) return;
+	molecule_position[i] = cell_members[list].size();
+	cell_members[list].push_back(i);
 }
 
 
@@ -69,6 +149,7 @@ void Species::fill_uniform(const Vect3d low, const Vect3d high, const unsigned i
 
 void Species::fill_uniform(const Vect3d low, const Vect3d high, const Box &interface, const unsigned int N) {
 	LOG(2,"Adding "<<N<<" molecules of Species ("<<id<<") within the rectangle defined by "<<low<<" and "<<high);
+	synchronise();
 	boost::variate_generator<base_generator_type&, boost::uniform_real<> > uni(generator, boost::uniform_real<>(0,1));
 	const Vect3d dist = high-low;
 	for(int i=0;i<N;i++) {
@@ -106,24 +187,40 @@ vtkSmartPointer<vtkUnstructuredGrid> Species::get_vtk() {
 
 int Molecules::add_molecule(const Vect3d& position) {
 	this->push_back(position, position, true, next_id++, SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE);
+	if (index_grid != NULL) {
+		molecule_list.push_back(-1);
+		molecule_position.push_back(-1);
+		update_cell_index(this->size()-1);
+	}
+	return this->size()-1;
 }
 int Molecules::add_molecule(const Vect3d& position, const Vect3d& old_position) {
 	this->push_back(position, old_position, true, next_id++, SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE);
+	if (index_grid != NULL) {
+		molecule_list.push_back(-1);
+		molecule_position.push_back(-1);
+		update_cell_index(this->size()-1);
+	}
+	return this->size()-1;
 }
 
 int Molecules::delete_molecules() {
    int i = 0;
+   int n = 0;
    while (i < this->size()) {
 		if (!alive[i]) {
 			delete_molecule(i);
+			n++;
 		} else {
 		   i++;
 		}
 	}
+   return n;
 }
 
 int Molecules::mark_for_deletion(const unsigned int i) {
 	alive[i] = false;
+	return i;
 }
 
 void Molecules::save_indicies() {
@@ -137,6 +234,7 @@ void Molecules::save_indicies() {
 void Species::get_concentrations(const StructuredGrid& calc_grid,
 		std::vector<double>& mol_concentrations,
 		std::vector<double>& compartment_concentrations) const {
+	synchronise();
 
 	mol_concentrations.assign(calc_grid.size(),0);
 	BOOST_FOREACH(Vect3d r,mols.r) {
@@ -213,7 +311,12 @@ void Species::get_concentration(const Vect3d low, const Vect3d high, const Vect3
 //	}
 }
 
+void Species::synchronise() const {
+	if (background != NULL) background->synchronise();
+}
+
 std::string Species::get_status_string() const {
+	synchronise();
 	const int ncomp = std::accumulate(copy_numbers.begin(),copy_numbers.end(),0);
 	std::ostringstream ss;
 	ss << "Species "<<id<<":\t" << mols.size() + ncomp << " particles.";
@@ -30,6 +30,7 @@
 #include "MyRandom.h"
 #include "Vector.h"
 #include "StructuredGrid.h"
+#include "CopyNumbers.h"
 
 #include <vtkUnstructuredGrid.h>
 #include <vtkSmartPointer.h>
@@ -47,7 +48,9 @@ class Molecules: public MolData {
 public:
 	Molecules() {
 		next_id = 0;
+		index_grid = NULL;
 	}
+	virtual void clear();
 	void fill_uniform(const Vect3d low, const Vect3d high, const unsigned int N);
 	int delete_molecule(const unsigned int i);
 	int delete_molecules();
@@ -58,8 +61,53 @@ public:
 
 	void save_indicies();
 	vtkSmartPointer<vtkUnstructuredGrid> get_vtk_grid();
+
+	/*
+	 * index of the molecules lying in a chosen set of cells of a grid (e.g.
+	 * the ghost cells of a NextSubvolumeMethod). Adding and deleting
+	 * molecules keeps it up to date, anything that moves a molecule must call
+	 * update_cell_index(i) afterwards
+	 */
+	void add_cell_index(const Grid* grid, const std::vector<int>& cells);
+	void update_cell_index();
+	bool has_cell_index() const { return index_grid != NULL; }
+	void update_cell_index(const unsigned int i) {
+		if (index_grid == NULL) return;
+		update_cell_index(i,index_grid->is_in(r[i]) ? index_grid->get_cell_index(r[i]) : -1);
+	}
+	void update_cell_index(const unsigned int i, const int cell) {
+		if (index_grid == NULL) return;
+		const int list = ((cell >= 0) && (cell < int(cell_lists.size()))) ? cell_lists[cell] : -1;
+		if (list == molecule_list[i]) return;
+		remove_from_cell_index(i);
+		insert_into_cell_index(i,list);
+	}
+	bool is_cell_indexed(const int cell) const {
+		return (index_grid != NULL) && (cell_lists[cell] >= 0);
+	}
+	int get_number_in_cell(const int cell) const {
+		return cell_members[cell_lists[cell]].size();
+	}
+	int get_random_molecule_in_cell(const int cell, const double rand) const {
+		const std::vector<int>& members = cell_members[cell_lists[cell]];
+		return members[int(rand*members.size())];
+	}
+	/*
+	 * true if the index of cell lists exactly the molecules lying in it.
+	 * Scans all the molecules, for assertions only
+	 */
+	bool is_cell_index_consistent(const int cell) const;
 private:
+	void remove_from_cell_index(const unsigned int i);
+	void insert_into_cell_index(const unsigned int i, const int list);
+
 	int next_id;
+
+	const Grid* index_grid;
+	std::vector<int> cell_lists;
+	std::vector<std::vector<int> > cell_members;
+	std::vector<int> molecule_list;
+	std::vector<int> molecule_position;
 };
 
 
@@ -69,21 +117,23 @@ const int SPECIES_SAVED_INDEX_FOR_NEW_PARTICLE = -1;
 
 static const StructuredGrid empty_grid;
 
+class Operator;
+
 class Species {
 public:
-	Species(double D):D(D,D,D),grid(NULL) {
+	Species(double D):D(D,D,D),grid(NULL),background(NULL) {
 		id = species_count++;
 		clear();
 	}
-	Species(double D, const StructuredGrid* grid):D(D,D,D),grid(grid)  {
+	Species(double D, const StructuredGrid* grid):D(D,D,D),grid(grid),background(NULL)  {
 		id = species_count++;
 		clear();
 	}
-	Species(Vect3d D):D(D),grid(NULL) {
+	Species(Vect3d D):D(D),grid(NULL),background(NULL) {
 		id = species_count++;
 		clear();
 	}
-	Species(Vect3d D, const StructuredGrid* grid):D(D),grid(grid)  {
+	Species(Vect3d D, const StructuredGrid* grid):D(D),grid(grid),background(NULL)  {
 		id = species_count++;
 		clear();
 	}
@@ -108,17 +158,23 @@ public:
 	void get_concentration(const Vect3d low, const Vect3d high, const Vect3i n, std::vector<double>& concentration) const;
 	vtkSmartPointer<vtkUnstructuredGrid> get_vtk();
 	std::string get_status_string() const;
+	/*
+	 * wait for the operator (if any) still changing the copy numbers in the
+	 * background, before reading or writing them
+	 */
+	void synchronise() const;
 	friend std::ostream& operator<<( std::ostream& out, const Species& b ) {
 		return out << b.get_status_string();
 	}
 
 	Vect3d D;
 	Molecules mols;
-	std::vector<int> copy_numbers;
+	CopyNumbers copy_numbers;
 	std::vector<int> mol_copy_numbers;
 	const Grid* grid;
 	int id;
 	std::vector<double> tmpx,tmpy,tmpz;
+	Operator* background;
 private:
 	static int species_count;
 };
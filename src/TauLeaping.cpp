@@ -0,0 +1,457 @@
+/*
+ * TauLeaping.cpp
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#include "TauLeaping.h"
+#include "Log.h"
+#include <limits>
+#include <algorithm>
+#include <boost/foreach.hpp>
+
+namespace Tyche {
+
+TauLeaping::TauLeaping(Grid& subvolumes):
+		NextSubvolumeMethod(subvolumes),
+		epsilon(0.03),
+		critical_number(10),
+		langevin_threshold(100),
+		number_of_leaps(0),
+		leaping_sorted(true),
+		changed_subvolumes(subvolumes.size()),
+		leaped_subvolumes(subvolumes.size()),
+		norm(generator,boost::normal_distribution<>(0,1)) {
+	critical.assign(subvolumes.size(),0);
+	critical_position.assign(subvolumes.size(),-1);
+	leaping_position.assign(subvolumes.size(),-1);
+}
+
+void TauLeaping::reset_all_priorities() {
+	const int n = subvolumes.size();
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; ++i) {
+		reset_propensities(i);
+	}
+	for (int i = 0; i < n; ++i) {
+		changed_subvolumes.mark(i);
+	}
+}
+
+void TauLeaping::schedule(const int i, const bool) {
+	changed_subvolumes.mark(i);
+}
+
+void TauLeaping::reschedule(const int i, const double) {
+	changed_subvolumes.mark(i);
+}
+
+void TauLeaping::integrate(const double dt) {
+	if (!dependency_graph_valid) build_dependency_graph();
+	const int nkeys = get_species().size()*subvolumes.size();
+	if (int(drift.size()) != nkeys) {
+		drift.assign(nkeys,0);
+		variance.assign(nkeys,0);
+		highest_order.assign(nkeys,0);
+		products.assign(nkeys,0);
+		changed_keys = DirtyCells(nkeys);
+	}
+
+	time = get_time();
+	refresh_rate_parameters();
+	flush_dirty_cells();
+	const double final_time = time + dt;
+	while (time < final_time) {
+		classify_changed_subvolumes();
+		sort_leaping_subvolumes();
+		const double tau = std::min(select_tau(),final_time-time);
+		ssa(time+tau);
+		leap(tau);
+		update_changed_copy_numbers();
+		time += tau;
+		number_of_leaps++;
+	}
+	time = final_time;
+}
+
+void TauLeaping::classify_changed_subvolumes() {
+	const std::vector<int>& cells = changed_subvolumes.get();
+	const int n = cells.size();
+	for (int k = 0; k < n; ++k) {
+		classify_subvolume(cells[k]);
+	}
+	changed_subvolumes.clear();
+}
+
+void TauLeaping::update_changed_copy_numbers() {
+	/*
+	 * most copy numbers of a leaped subvolume change, so each subvolume
+	 * depending on them is recalculated once rather than reaction by
+	 * reaction
+	 */
+	const std::vector<int>& keys = changed_keys.get();
+	const int nk = keys.size();
+	for (int k = 0; k < nk; ++k) {
+		mark_dependent_subvolumes(keys[k],leaped_subvolumes);
+		if (watch_changed_cells) changed_cells.mark(keys[k]%subvolumes.size());
+	}
+	changed_keys.clear();
+	const std::vector<int>& cells = leaped_subvolumes.get();
+	const int n = cells.size();
+	for (int k = 0; k < n; ++k) {
+		reset_propensities(cells[k]);
+		changed_subvolumes.mark(cells[k]);
+	}
+	leaped_subvolumes.clear();
+}
+
+void TauLeaping::classify_subvolume(const int i) {
+	ReactionList& reactions = subvolume_reactions[i];
+	char is_critical = 0;
+	if (reactions.get_propensity() != 0) {
+		const StoichiometryTable& table = reactions.get_stoichiometry();
+		const int nr = reactions.get_reactions().size();
+		for (int r = 0; (r < nr) && !is_critical; ++r) {
+			if (reactions.get_reaction_propensity(r) == 0) continue;
+			const int end = table.offsets[reactions.get_rhs_offset(r+1)];
+			for (int e = table.offsets[reactions.get_rhs_offset(r)]; e < end; ++e) {
+				const int c = reactions.get_compartment_index(e);
+				if ((c < 0) ||
+						((table.delta[e] < 0) && (table.species[e]->copy_numbers[c] < -table.delta[e]*critical_number))) {
+					is_critical = 1;
+					break;
+				}
+			}
+		}
+	}
+	const bool is_leaping = !is_critical && (reactions.get_propensity() != 0);
+	if (is_leaping && (leaping_position[i] < 0)) {
+		add_leaping_subvolume(i);
+	} else if (!is_leaping && (leaping_position[i] >= 0)) {
+		const int p = leaping_position[i];
+		leaping_subvolumes[p] = leaping_subvolumes.back();
+		leaping_position[leaping_subvolumes[p]] = p;
+		leaping_subvolumes.pop_back();
+		leaping_position[i] = -1;
+		leaping_sorted = false;
+	}
+	if (is_critical == critical[i]) return;
+	critical[i] = is_critical;
+	if (is_critical) {
+		critical_position[i] = critical_subvolumes.size();
+		critical_subvolumes.push_back(i);
+	} else {
+		const int p = critical_position[i];
+		critical_subvolumes[p] = critical_subvolumes.back();
+		critical_position[critical_subvolumes[p]] = p;
+		critical_subvolumes.pop_back();
+		critical_position[i] = -1;
+	}
+}
+
+void TauLeaping::add_leaping_subvolume(const int i) {
+	leaping_position[i] = leaping_subvolumes.size();
+	leaping_subvolumes.push_back(i);
+	leaping_sorted = false;
+}
+
+void TauLeaping::sort_leaping_subvolumes() {
+	if (leaping_sorted) return;
+	std::sort(leaping_subvolumes.begin(),leaping_subvolumes.end());
+	const int nl = leaping_subvolumes.size();
+	for (int k = 0; k < nl; ++k) {
+		leaping_position[leaping_subvolumes[k]] = k;
+	}
+	leaping_sorted = true;
+}
+
+double TauLeaping::select_tau() {
+	const int n = subvolumes.size();
+
+	/*
+	 * expected change (drift) and variance of every copy number affected by
+	 * the leaped subvolumes over unit time
+	 */
+	BOOST_FOREACH(int i, leaping_subvolumes) {
+		ReactionList& reactions = subvolume_reactions[i];
+		const StoichiometryTable& table = reactions.get_stoichiometry();
+		const std::vector<ReactionsWithSameRateAndLHS>& channels = reactions.get_reactions();
+		const int nr = channels.size();
+		for (int r = 0; r < nr; ++r) {
+			const double a = reactions.get_reaction_propensity(r);
+			if (a == 0) continue;
+			const int first_rhs = reactions.get_rhs_offset(r);
+			const int nrhs = reactions.get_rhs_offset(r+1) - first_rhs;
+			for (int j = 0; j < nrhs; ++j) {
+				const double a_rhs = a*channels[r].get_rhs_fraction(j);
+				const int end = table.offsets[first_rhs+j+1];
+				for (int e = table.offsets[first_rhs+j]; e < end; ++e) {
+					const int key = get_copy_number_key(table.species[e],reactions.get_compartment_index(e));
+					if ((drift[key] == 0) && (variance[key] == 0)) touched_keys.push_back(key);
+					drift[key] += table.delta[e]*a_rhs;
+					variance[key] += table.delta[e]*table.delta[e]*a_rhs;
+				}
+			}
+
+			/*
+			 * highest order of reaction of each reactant, giving the g_i of
+			 * Cao et al.
+			 */
+			const int end = table.offsets[first_rhs+1];
+			int order = 0;
+			for (int e = table.offsets[first_rhs]; e < end; ++e) {
+				if (table.delta[e] < 0) order -= table.delta[e];
+			}
+			for (int e = table.offsets[first_rhs]; e < end; ++e) {
+				if (table.delta[e] >= 0) continue;
+				const int key = get_copy_number_key(table.species[e],reactions.get_compartment_index(e));
+				double g = order;
+				if ((order == 2) && (table.delta[e] == -2)) {
+					g = 2.0 + 1.0/(get_copy_number(key)-1);
+				}
+				if (g > highest_order[key]) highest_order[key] = g;
+			}
+		}
+	}
+
+	double tau = std::numeric_limits<double>::infinity();
+	const int nt = touched_keys.size();
+	for (int k = 0; k < nt; ++k) {
+		const int key = touched_keys[k];
+		if (!critical[key%n]) {
+			const double g = highest_order[key] > 0 ? highest_order[key] : 1.0;
+			const double bound = std::max(epsilon*get_copy_number(key)/g,1.0);
+			if (drift[key] != 0) tau = std::min(tau,bound/std::abs(drift[key]));
+			if (variance[key] != 0) tau = std::min(tau,bound*bound/variance[key]);
+		}
+		drift[key] = 0;
+		variance[key] = 0;
+		highest_order[key] = 0;
+	}
+	touched_keys.clear();
+	return tau;
+}
+
+void TauLeaping::ssa(const double final_time) {
+	/*
+	 * direct method over the critical subvolumes. Their propensities are
+	 * kept in a Fenwick tree (by position in critical_subvolumes), updated
+	 * from the subvolumes marked dirty by each event
+	 */
+	const int nc = critical_subvolumes.size();
+	double total_propensity = build_critical_tree();
+	double t = time;
+	while (total_propensity > 0) {
+		double rand = uni();
+		while (rand==0.0) rand = uni();
+		t -= log(rand)/total_propensity;
+		if (t > final_time) break;
+
+		const int sv_i = critical_subvolumes[pick_critical_subvolume(uni()*total_propensity)];
+		ReactionList& reactions = subvolume_reactions[sv_i];
+		if (reactions.get_propensity() == 0) continue;
+		const int k = reactions.pick_random_reaction(uni());
+		if (count_activity) count_event(sv_i,k);
+		dirty_subvolumes.clear();
+		mark_dirty(sv_i);
+		fire(reactions,k);
+		number_of_events++;
+
+		const int nd = dirty_subvolumes.size();
+		for (int d = 0; d < nd; ++d) {
+			const int i = dirty_subvolumes[d].first;
+			changed_subvolumes.mark(i);
+			if (critical[i]) {
+				const double delta = subvolume_reactions[i].get_propensity() - dirty_subvolumes[d].second;
+				if (delta == 0) continue;
+				for (int j = critical_position[i]+1; j <= nc; j += j & (-j)) {
+					critical_tree[j-1] += delta;
+				}
+				total_propensity += delta;
+			}
+		}
+		if (total_propensity <= 1e-9) total_propensity = build_critical_tree();
+	}
+}
+
+double TauLeaping::build_critical_tree() {
+	const int n = critical_subvolumes.size();
+	critical_tree.resize(n);
+	double total = 0;
+	for (int k = 0; k < n; ++k) {
+		critical_tree[k] = subvolume_reactions[critical_subvolumes[k]].get_propensity();
+		total += critical_tree[k];
+	}
+	for (int j = 1; j <= n; ++j) {
+		const int parent = j + (j & (-j));
+		if (parent <= n) critical_tree[parent-1] += critical_tree[j-1];
+	}
+	return total;
+}
+
+int TauLeaping::pick_critical_subvolume(const double rand_times_total_propensity) const {
+	const int n = critical_tree.size();
+	int step = 1;
+	while (2*step <= n) step *= 2;
+	int i = 0;
+	double remaining = rand_times_total_propensity;
+	for (; step > 0; step /= 2) {
+		if ((i+step <= n) && (critical_tree[i+step-1] <= remaining)) {
+			i += step;
+			remaining -= critical_tree[i-1];
+		}
+	}
+	// round-off in the tree can point past the last subvolume
+	return std::min(i,n-1);
+}
+
+void TauLeaping::leap(const double tau) {
+	const int n = subvolumes.size();
+
+	/*
+	 * the SSA events of this leap can give non-critical subvolumes a
+	 * propensity before they are classified again, they leap as well
+	 */
+	BOOST_FOREACH(int i, changed_subvolumes.get()) {
+		if (critical[i] || (leaping_position[i] >= 0) || (subvolume_reactions[i].get_propensity() == 0)) continue;
+		add_leaping_subvolume(i);
+	}
+	sort_leaping_subvolumes();
+	BOOST_FOREACH(int i, leaping_subvolumes) {
+		if (subvolume_reactions[i].get_propensity() == 0) continue;
+		leap_subvolume(i,tau);
+	}
+
+	/*
+	 * products are added after all subvolumes have leaped, so that reactants
+	 * are only taken from the copy numbers at the start of the leap
+	 */
+	const int np = product_keys.size();
+	for (int k = 0; k < np; ++k) {
+		const int key = product_keys[k];
+		get_species()[key/n]->copy_numbers[key%n] += products[key];
+		products[key] = 0;
+		changed_keys.mark(key);
+	}
+	product_keys.clear();
+}
+
+void TauLeaping::leap_subvolume(const int i, const double tau) {
+	ReactionList& reactions = subvolume_reactions[i];
+	const StoichiometryTable& table = reactions.get_stoichiometry();
+	const std::vector<ReactionsWithSameRateAndLHS>& channels = reactions.get_reactions();
+	const int nr = channels.size();
+
+	/*
+	 * firing probabilities of each channel from the copy numbers at the
+	 * start of the leap. A channel without reactants fires a Poisson
+	 * number of times (max firings < 0)
+	 */
+	channel_max_firings.resize(nr);
+	channel_probability.resize(nr);
+	for (int r = 0; r < nr; ++r) {
+		const double a = reactions.get_reaction_propensity(r);
+		channel_max_firings[r] = 0;
+		if (a == 0) continue;
+		const int first_rhs = reactions.get_rhs_offset(r);
+		const int end = table.offsets[first_rhs+1];
+		int max_firings = -1;
+		for (int e = table.offsets[first_rhs]; e < end; ++e) {
+			if (table.delta[e] >= 0) continue;
+			const int m = table.species[e]->copy_numbers[reactions.get_compartment_index(e)]/(-table.delta[e]);
+			if ((max_firings < 0) || (m < max_firings)) max_firings = m;
+		}
+		channel_max_firings[r] = max_firings;
+		channel_probability[r] = max_firings < 0 ? a*tau : std::min(1.0,a*tau/max_firings);
+	}
+
+	/*
+	 * draw the firings. Reactants are removed as we go, so the channels of
+	 * a subvolume can not together use more molecules than it has
+	 */
+	for (int r = 0; r < nr; ++r) {
+		if (channel_max_firings[r] == 0) continue;
+		const int first_rhs = reactions.get_rhs_offset(r);
+		int firings;
+		if (channel_max_firings[r] < 0) {
+			firings = sample_poisson(channel_probability[r]);
+		} else {
+			const int end = table.offsets[first_rhs+1];
+			int max_firings = channel_max_firings[r];
+			for (int e = table.offsets[first_rhs]; e < end; ++e) {
+				if (table.delta[e] >= 0) continue;
+				max_firings = std::min(max_firings,table.species[e]->copy_numbers[reactions.get_compartment_index(e)]/(-table.delta[e]));
+			}
+			firings = sample_binomial(max_firings,channel_probability[r]);
+		}
+		if (firings == 0) continue;
+		number_of_events += firings;
+
+		/*
+		 * split the firings multinomially between the rhs of the channel
+		 */
+		const int nrhs = reactions.get_rhs_offset(r+1) - first_rhs;
+		int remaining = firings;
+		double remaining_fraction = 1.0;
+		for (int j = 0; (j < nrhs) && (remaining > 0); ++j) {
+			const double fraction = channels[r].get_rhs_fraction(j);
+			const int n = (j == nrhs-1) ? remaining : sample_binomial(remaining,std::min(1.0,fraction/remaining_fraction));
+			remaining -= n;
+			remaining_fraction -= fraction;
+			if (n == 0) continue;
+			if (count_activity) count_event(i,first_rhs+j,n);
+			const int end = table.offsets[first_rhs+j+1];
+			for (int e = table.offsets[first_rhs+j]; e < end; ++e) {
+				if (table.delta[e] < 0) {
+					const int c = reactions.get_compartment_index(e);
+					table.species[e]->copy_numbers[c] += n*table.delta[e];
+					changed_keys.mark(get_copy_number_key(table.species[e],c));
+				} else {
+					add_product(get_copy_number_key(table.species[e],reactions.get_compartment_index(e)),n*table.delta[e]);
+				}
+			}
+		}
+	}
+}
+
+void TauLeaping::add_product(const int key, const int n) {
+	if (products[key] == 0) product_keys.push_back(key);
+	products[key] += n;
+}
+
+int TauLeaping::sample_binomial(const int n, const double p) {
+	if ((n == 0) || (p <= 0)) return 0;
+	if (p >= 1) return n;
+	const double mean = n*p;
+	if ((mean > langevin_threshold) && (n-mean > langevin_threshold)) {
+		const int k = int(floor(mean + sqrt(mean*(1-p))*norm() + 0.5));
+		return std::max(0,std::min(n,k));
+	}
+	boost::random::binomial_distribution<int> binomial(n,p);
+	return binomial(generator);
+}
+
+int TauLeaping::sample_poisson(const double mean) {
+	if (mean <= 0) return 0;
+	if (mean > langevin_threshold) {
+		return std::max(0,int(floor(mean + sqrt(mean)*norm() + 0.5)));
+	}
+	boost::random::poisson_distribution<int> poisson(mean);
+	return poisson(generator);
+}
+
+void TauLeaping::print(std::ostream& out) const {
+	out << "\tTau Leaping (epsilon = "<<epsilon<<", critical number = "<<critical_number<<
+			", Langevin threshold = "<<langevin_threshold<<"):"<<std::endl;
+	out << "\t\tGrid:"<<std::endl;
+	out << "\t\t\tlow = "<<get_grid().get_low() << " high = "<<get_grid().get_high()<<std::endl;
+	out << "\t\tDiffusing Species:"<<std::endl;
+	for (unsigned int i = 0; i < get_species().size(); ++i) {
+		Species *s = get_species()[i];
+		out <<"\t\t\tSpecies "<<s->id<<" (D = "<<s->D<<") has "<<
+					std::accumulate(s->copy_numbers.begin(),s->copy_numbers.end(),0)<<
+					" particles in compartments"<<std::endl;
+	}
+}
+
+}
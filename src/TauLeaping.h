@@ -0,0 +1,126 @@
+/*
+ * TauLeaping.h
+ *
+ *  Created on: 17 Oct 2026
+ */
+
+#ifndef TAULEAPING_H_
+#define TAULEAPING_H_
+
+#include "NextSubvolumeMethod.h"
+
+namespace Tyche {
+
+/*
+ * Approximate spatial SSA using the same grid, reactions and diffusion as the
+ * NextSubvolumeMethod. Subvolumes where every reactant is plentiful are
+ * advanced by binomial tau-leaping, switching to a Langevin (normal)
+ * approximation for channels expected to fire many times in a leap.
+ * Subvolumes with a reactant below the critical number, or with interface
+ * reactions, are advanced with the exact SSA over each leap.
+ *
+ * The leap is chosen so that the expected relative change of every leaped
+ * copy number is bounded by epsilon (Cao, Gillespie and Petzold 2006).
+ * Only the subvolumes depending on the copy numbers changed by a leap (found
+ * through the dependency graph) are recalculated and classified again, so
+ * a leap costs the work of the subvolumes it touches.
+ */
+class TauLeaping: public NextSubvolumeMethod {
+public:
+	TauLeaping(Grid& subvolumes);
+	static std::auto_ptr<TauLeaping> New(const Vect3d& min, const Vect3d& max, const Vect3d& h) {
+		Grid* grid = new StructuredGrid(min,max,h);
+		return std::auto_ptr<TauLeaping>(new TauLeaping(*grid));
+	}
+	static std::auto_ptr<TauLeaping> New(Grid& grid) {
+		return std::auto_ptr<TauLeaping>(new TauLeaping(grid));
+	}
+
+	void set_epsilon(const double eps) { epsilon = eps; }
+	double get_epsilon() const { return epsilon; }
+	void set_critical_number(const int n) { critical_number = n; }
+	int get_critical_number() const { return critical_number; }
+	void set_langevin_threshold(const double n) { langevin_threshold = n; }
+	double get_langevin_threshold() const { return langevin_threshold; }
+	unsigned long get_number_of_leaps() const { return number_of_leaps; }
+
+	virtual void reset_all_priorities();
+
+protected:
+	virtual void integrate(const double dt);
+	virtual void print(std::ostream& out) const;
+	/*
+	 * there is no event queue, a subvolume whose propensity changed is
+	 * only classified again before the next leap
+	 */
+	virtual void schedule(const int i, const bool in_queue);
+	virtual void reschedule(const int i, const double old_propensity);
+
+private:
+	void classify_changed_subvolumes();
+	void classify_subvolume(const int i);
+	void add_leaping_subvolume(const int i);
+	void sort_leaping_subvolumes();
+	void update_changed_copy_numbers();
+	double select_tau();
+	void ssa(const double final_time);
+	/*
+	 * fill critical_tree from the propensities of the critical subvolumes,
+	 * returning their sum
+	 */
+	double build_critical_tree();
+	int pick_critical_subvolume(const double rand_times_total_propensity) const;
+	void leap(const double tau);
+	void leap_subvolume(const int i, const double tau);
+	void add_product(const int key, const int n);
+	int sample_binomial(const int n, const double p);
+	int sample_poisson(const double mean);
+	int get_copy_number(const int key) const {
+		const int n = subvolumes.size();
+		return get_species()[key/n]->copy_numbers[key%n];
+	}
+
+	double epsilon;
+	int critical_number;
+	double langevin_threshold;
+	unsigned long number_of_leaps;
+
+	std::vector<char> critical;
+	std::vector<int> critical_subvolumes;
+	std::vector<int> critical_position;
+	std::vector<double> critical_tree;
+
+	/*
+	 * the non-critical subvolumes with a non-zero propensity, sorted
+	 * before each leap if it changed so they leap in subvolume order
+	 */
+	std::vector<int> leaping_subvolumes;
+	std::vector<int> leaping_position;
+	bool leaping_sorted;
+
+	/*
+	 * subvolumes to classify again, copy numbers changed by the leap (by
+	 * key, see get_copy_number_key) and the subvolumes depending on them
+	 */
+	DirtyCells changed_subvolumes;
+	DirtyCells changed_keys;
+	DirtyCells leaped_subvolumes;
+
+	/*
+	 * scratch space indexed by copy number key (see get_copy_number_key)
+	 */
+	std::vector<double> drift;
+	std::vector<double> variance;
+	std::vector<double> highest_order;
+	std::vector<int> products;
+	std::vector<int> touched_keys;
+	std::vector<int> product_keys;
+
+	std::vector<int> channel_max_firings;
+	std::vector<double> channel_probability;
+	boost::variate_generator<base_generator_type&, boost::normal_distribution<> > norm;
+};
+
+}
+
+#endif /* TAULEAPING_H_ */
@@ -28,13 +28,16 @@
 namespace Tyche {
 
 base_generator_type generator;
+unsigned long generator_seeds = 0;
 
 void init(int argc, char *argv[]) {
 	generator.seed(time(NULL));
+	generator_seeds++;
 }
 
 void random_seed(unsigned int seed) {
   generator.seed(seed);
+  generator_seeds++;
 }
 
 }
@@ -26,8 +26,18 @@
 #define TYCHE_H_
 
 #include "Species.h"
+#include "CopyNumbers.h"
+#include "RateParameter.h"
+#include "DirtyCells.h"
 #include "Diffusion.h"
+#include "MoleculeBlocks.h"
+#include "BrownianKernel.h"
+#include "LatticeDiffusion.h"
+#include "FiniteVolumeMethod.h"
 #include "NextSubvolumeMethod.h"
+#include "TauLeaping.h"
+#include "ParallelNextSubvolumeMethod.h"
+#include "CompositionRejection.h"
 #include "MyRandom.h"
 #include "Boundary.h"
 #include "Geometry.h"
@@ -100,6 +100,7 @@ void Visualisation::integrate(const double dt) {
 		LOG(2, "Starting Operator: " << *this);
 		my_vtk_data->renderer->RemoveAllViewProps();
 		BOOST_FOREACH(Species* s, this->get_species()) {
+			s->synchronise();
 			add_molecules_to_vis(*s);
 			add_compartments_to_vis(*s);
 		}